@@ -1,78 +1,87 @@
 #include "Json.h"
+#include "MappedFile.h"
+#include "StructuralIndex.h"
 #include <iostream>
 #include <fstream>
+#include <cstring>
+#include <cstddef>
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <numeric>
+#include <type_traits>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
 
-std::set<char> WHITESPACE_CHARS{
-	' ',
-	'\n',
-	'\t',
-	'\r'
-};
+static_assert(sizeof(Json) <= 16, "Json values are expected to stay 16 bytes wide");
 
 Json::Json(const Json& other)
-	:var_(new Var)
 {
-	var_->Copy(other.var_);
+	var_.Copy(other.var_, HeapResource());
 }
 
 Json::Json(Json&& other) noexcept
+	:var_(other.var_)
 {
-	var_ = std::move(other.var_);
+	other.var_ = Var();
 }
 
 Json::Json(const Type type)
-	:var_(new Var)
 {
-	var_->type = type;
-	switch (type)
-	{
-	case Type::String:
-		var_->stringVal = new std::string();
-		break;
-	case Type::Array:
-		var_->arrayVal = new std::vector<Json>;
-		break;
-	case Type::Object:
-		var_->objectVal = new std::map<std::string, Json>;
-		break;
-	default:
-		break;
-	}
+	var_.Emplace(type, HeapResource());
 }
 
 Json::Json(const bool bval)
-	:var_(new Var)
 {
-	var_->type = Type::Bool;
-	var_->boolVal = bval;
+	var_.type = Type::Bool;
+	var_.boolVal = bval;
 }
 
 Json::Json(const int val)
-	:var_(new Var)
 {
-	var_->type = Type::Int;
-	var_->intVal = val;
+	var_.type = Type::Int;
+	var_.intVal = val;
 }
 
 Json::Json(const float val)
-	:var_(new Var)
 {
-	var_->type = Type::Float;
-	var_->floatVal = val;
+	var_.type = Type::Float;
+	var_.floatVal = val;
+}
+
+Json::Json(const int64_t val)
+{
+	var_.type = Type::Int64;
+	var_.int64Val = val;
+}
+
+Json::Json(const double val)
+{
+	var_.type = Type::Double;
+	var_.doubleVal = val;
 }
 
 Json::Json(const char* str)
-	:var_(new Var)
 {
-	var_->type = Type::String;
-	var_->stringVal = new std::string(str);
+	var_.SetString(str, HeapResource());
 }
 
 Json::Json(const std::string& str)
-	:var_(new Var)
 {
-	var_->type = Type::String;
-	var_->stringVal = new std::string(str);
+	var_.SetString(str, HeapResource());
 }
 
 Json::Json(std::initializer_list<std::pair<const std::string, const Json>> args)
@@ -85,734 +94,5411 @@ Json::Json(JsonArrayWrapper args)
 	*this = JArray(args.jArray);
 }
 
-Json::~Json() noexcept = default;
+Json::~Json() noexcept
+{
+	var_.Release();
+}
 
-const bool Json::Compare(const std::vector<Json>& a, const std::vector<Json>& b)
+std::pmr::memory_resource* Json::HeapResource()
 {
-	if (a.size() != b.size())
-		return false;
+	//Plain operator new, std::pmr::new_delete_resource may take the slower aligned allocation path for every node
+	struct Heap final : std::pmr::memory_resource
+	{
+		void* do_allocate(size_t bytes, size_t alignment) override
+		{
+			if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+				return ::operator new(bytes, std::align_val_t(alignment));
+			return ::operator new(bytes);
+		}
+		void do_deallocate(void* ptr, size_t, size_t alignment) override
+		{
+			if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+				::operator delete(ptr, std::align_val_t(alignment));
+			else
+				::operator delete(ptr);
+		}
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+	};
+	static Heap heap;
+	return &heap;
+}
 
-	for (size_t i = 0; i < a.size(); i++)
+Json Json::Make(const Type type, std::pmr::memory_resource* resource, const ObjectOrder order)
+{
+	Json result;
+	result.var_.Emplace(type, resource, order);
+	return result;
+}
+
+Json Json::Clone(const Json& src, std::pmr::memory_resource* resource)
+{
+	Json result;
+	result.var_.Copy(src.var_, resource);
+	return result;
+}
+
+//Reference count in front of the storage of a shared node, so the node's pointer stays the one every reader uses
+struct alignas(std::max_align_t) Json::SharedCount
+{
+	std::atomic<uint32_t> refs;
+	std::atomic<uint64_t> hash{ 0 };	//Zero until Hash is asked for
+};
+
+template<typename T, typename ... Args>
+T* Json::CreateShared(std::pmr::memory_resource* resource, Args&& ... args)
+{
+	auto* memory = static_cast<char*>(resource->allocate(sizeof(SharedCount) + sizeof(T), alignof(SharedCount)));
+	new (memory) SharedCount{ 1 };
+	return new (memory + sizeof(SharedCount)) T(std::forward<Args>(args)..., typename T::allocator_type(resource));
+}
+
+//Moves unshared storage into a counted block
+template<typename T>
+T* Json::MakeShared(T* ptr)
+{
+	auto* shared = CreateShared<T>(ptr->get_allocator().resource(), std::move(*ptr));
+	Destroy(ptr);
+	return shared;
+}
+
+template<typename T>
+void Json::ReleaseShared(T* ptr) noexcept
+{
+	auto* count = reinterpret_cast<SharedCount*>(reinterpret_cast<char*>(ptr) - sizeof(SharedCount));
+	if (count->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+	auto* resource = ptr->get_allocator().resource();
+	ptr->~T();
+	count->~SharedCount();
+	resource->deallocate(count, sizeof(SharedCount) + sizeof(T), alignof(SharedCount));
+}
+
+void Json::Share()
+{
+	var_.Share();
+}
+
+Json Json::Freeze() const
+{
+	Json frozen;
+	frozen.var_.Duplicate(var_, HeapResource(), false);
+	frozen.Share();
+	return frozen;
+}
+
+bool Json::IsShared() const
+{
+	return var_.IsShared();
+}
+
+const Json* Json::Find(const Path& path) const
+{
+	auto* node = this;
+	for (size_t i = 0; node && i < path.segments.size(); i++)
+		node = node->Child(path, i);
+	return node;
+}
+
+Json* Json::Find(const Path& path)
+{
+	return Resolve(path, path.Size());
+}
+
+//Finds the node after the first count segments of path, unsharing the ones above it
+Json* Json::Resolve(const Path& path, const size_t count)
+{
+	const Json* found = this;
+	for (size_t i = 0; found && i < count; i++)
+		found = found->Child(path, i);
+	if (!found)
+		return nullptr;
+	auto* node = this;
+	std::pmr::memory_resource* resource = nullptr;
+	for (size_t i = 0; i < count; i++)
 	{
-		if (a[i] != b[i])
-			return false;
+		node->var_.Detach();
+		resource = node->var_.Resource();
+		if (node->GetType() == Type::Array)
+			node = &(*node->var_.arrayVal)[path.segments[i].index];
+		else
+			node = const_cast<Json*>(node->Child(path, i));
 	}
-	return true;
+	return resource ? &HandOut(*node, resource) : node;
 }
 
-const bool Json::Compare(const std::map<std::string, Json>& a, const std::map<std::string, Json>& b)
+//The nodes resolved for one path stay on the stack for the prefix the next one shares with it
+std::vector<const Json*> Json::FindAll(const PathSet& paths) const
 {
-	std::set<std::string> keys;
-	for (const auto& aPair : a)
-		(void)keys.insert(aPair.first);
-
-	for (const auto& bPair : b)
+	std::vector<const Json*> results(paths.Size());
+	std::vector<const Json*> nodes{ this };
+	for (const auto& step : paths.steps)
 	{
-		const auto aVal = keys.find(bPair.first);
-		if (aVal == keys.end())
-			return false;
-		(void)keys.erase(bPair.first);
+		const auto& path = paths[step.index];
+		nodes.resize(std::min<size_t>(step.shared, nodes.size() - 1) + 1);
+		for (auto i = nodes.size() - 1; i < path.Size() && nodes.back(); i++)
+			nodes.push_back(nodes.back()->Child(path, i));
+		results[step.index] = nodes.size() == path.Size() + 1 ? nodes.back() : nullptr;
 	}
-	if (!keys.empty())
-		return false;
-	for (auto it = a.begin(); it != a.end(); it++)
+	return results;
+}
+
+const Json* Json::Child(const Path& path, const size_t i) const
+{
+	const auto& segment = path.segments[i];
+	switch (GetType())
 	{
-		const auto bVal = b.find(it->first);
-		if (it->second != bVal->second)
-			return false;
+	case Type::Object:	return var_.objectVal->Find(path.Key(i), segment.hash);
+	case Type::Array:	return segment.index < var_.arrayVal->size() ? &(*static_cast<const ArrayStorage*>(var_.arrayVal))[segment.index] : nullptr;
+	default:			return nullptr;
 	}
-	return true;
 }
 
-size_t Json::FindFirstNotOf(const std::string& str, std::set<char> del, const bool bAsc)
+Json::Path::Path(std::string_view path)
 {
-	if (bAsc)
-		for (size_t i = 0; i < str.length(); i++)
+	if (path.empty())
+		return;
+	if (path[0] != '/')
+	{
+		for (size_t begin{ 0 };;)
 		{
-			const auto it = del.find(str[i]);
-			if (it == del.end())
-				return i;
+			const auto end = std::min(path.find('.', begin), path.length());
+			Append(path.substr(begin, end - begin));
+			if (end == path.length())
+				return;
+			begin = end + 1;
 		}
-	else
-		for (size_t i = str.length()-1; i >= 0; i--)
+	}
+
+	std::string key;
+	for (size_t i = 1; i <= path.length(); i++)
+	{
+		if (i == path.length() || path[i] == '/')
 		{
-			const auto it = del.find(str[i]);
-			if (it == del.end())
-				return i;
+			Append(key);
+			key.clear();
 		}
-	return 0;
+		else if (path[i] == '~' && i + 1 < path.length() && (path[i + 1] == '0' || path[i + 1] == '1'))
+			key.push_back(path[++i] == '0' ? '~' : '/');
+		else
+		{
+			assert(path[i] != '~' && "Json::Path: ~ has to be escaped as ~0");
+			key.push_back(path[i]);
+		}
+	}
 }
 
-const Json::Type Json::GetType() const
+Json::Path::Path(const char* path)
+	:Path(std::string_view(path))
 {
-	return var_->type;
 }
 
-const size_t Json::Size() const
+Json::Path::Path(const std::string& path)
+	:Path(std::string_view(path))
 {
-	switch (GetType())
+}
+
+size_t Json::Path::Size() const
+{
+	return segments.size();
+}
+
+std::string_view Json::Path::Key(const size_t i) const
+{
+	const auto& segment = segments[i];
+	return std::string_view(keys.data() + segment.offset, segment.length);
+}
+
+void Json::Path::Append(std::string_view key)
+{
+	//Only digits without a leading zero make an index, as in RFC 6901
+	size_t index{ SIZE_MAX };
+	if (!key.empty() && (key.length() == 1 || key[0] != '0'))
 	{
-	case Type::Array:
-		return var_->arrayVal->size();
-	case Type::Object:
-		return var_->objectVal->size();
-	default:
-		return 0;
+		const auto result = std::from_chars(key.data(), key.data() + key.length(), index);
+		if (result.ec != std::errc() || result.ptr != key.data() + key.length())
+			index = SIZE_MAX;
 	}
+	segments.push_back({ (uint32_t)keys.length(), (uint32_t)key.length(), Json::Key::HashOf(key), index });
+	keys.append(key.data(), key.length());
 }
 
-Json& Json::Set(const std::string& key, const Json& value)
+Json::PathSet::PathSet(std::vector<Path> paths)
+	:paths(std::move(paths))
 {
-	assert(GetType() == Type::Object);
-	auto& objRef = (*var_->objectVal)[key];
-	objRef = value;
-	return objRef;
+	const auto common = [](const Path& a, const Path& b)
+	{
+		size_t i{ 0 };
+		while (i < a.Size() && i < b.Size() && a.Key(i) == b.Key(i))
+			i++;
+		return i;
+	};
+	std::vector<uint32_t> order(this->paths.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [this, &common](const uint32_t a, const uint32_t b)
+	{
+		const auto& pathA = this->paths[a];
+		const auto& pathB = this->paths[b];
+		const auto i = common(pathA, pathB);
+		if (i == pathA.Size() || i == pathB.Size())
+			return pathA.Size() < pathB.Size();
+		return pathA.Key(i) < pathB.Key(i);
+	});
+	steps.reserve(order.size());
+	for (size_t i = 0; i < order.size(); i++)
+		steps.push_back({ order[i], i > 0 ? (uint32_t)common(this->paths[order[i]], this->paths[order[i - 1]]) : 0 });
 }
 
-bool Json::Contains(const std::string& key) const
+size_t Json::PathSet::Size() const
 {
-	if (GetType() != Object)
-		return false;
-	return var_->objectVal->find(key) != var_->objectVal->end();
+	return paths.size();
 }
 
-Json Json::JObject(std::initializer_list<std::pair<const std::string, const Json>> args)
+const Json::Path& Json::PathSet::operator[](const size_t i) const
 {
-	Json result(Json::Type::Object);
-	for (const auto &arg : args)
-	{ 
-		result.Set(arg.first, arg.second);
+	return paths[i];
+}
+
+Json Json::Diff(const Json& a, const Json& b)
+{
+	Json patch(Type::Array);
+	std::string path;
+	DiffInto(a, b, path, patch);
+	return patch;
+}
+
+void Json::DiffInto(const Json& a, const Json& b, std::string& path, Json& patch)
+{
+	const auto type = a.GetType();
+	if (type == Type::Object && b.GetType() == Type::Object)
+	{
+		const ObjectStorage& objectA = *a.var_.objectVal;
+		const ObjectStorage& objectB = *b.var_.objectVal;
+		if (&objectA == &objectB)
+			return;
+		const auto length = path.length();
+		for (const auto& entry : objectA)
+		{
+			AppendToken(path, entry.first);
+			const auto other = objectB.Find(entry.first);
+			if (other)
+				DiffInto(entry.second, *other, path, patch);
+			else
+				AddOperation(patch, "remove", path);
+			path.resize(length);
+		}
+		for (const auto& entry : objectB)
+		{
+			if (objectA.Find(entry.first))
+				continue;
+			AppendToken(path, entry.first);
+			AddOperation(patch, "add", path).Set("value", entry.second);
+			path.resize(length);
+		}
+		return;
 	}
-	return result;
+	if (type == Type::Array && b.GetType() == Type::Array)
+	{
+		const ArrayStorage& arrayA = *a.var_.arrayVal;
+		const ArrayStorage& arrayB = *b.var_.arrayVal;
+		if (&arrayA == &arrayB)
+			return;
+		//Elements go through iterators, which read packed numbers without copying all of them into elements
+		const auto elementA = [&arrayA](const size_t i) { return ArrayStorage::const_iterator(&arrayA, i); };
+		const auto elementB = [&arrayB](const size_t i) { return ArrayStorage::const_iterator(&arrayB, i); };
+		//Only the middle that is left once equal leading and trailing elements are cut off is compared position by position
+		size_t begin{ 0 }, endA = arrayA.size(), endB = arrayB.size();
+		while (begin < endA && begin < endB && Identical(*elementA(begin), *elementB(begin)))
+			begin++;
+		while (endA > begin && endB > begin && Identical(*elementA(endA - 1), *elementB(endB - 1)))
+		{
+			endA--;
+			endB--;
+		}
+		const auto length = path.length();
+		const auto common = begin + std::min(endA - begin, endB - begin);
+		for (auto i = begin; i < common; i++)
+		{
+			AppendToken(path, std::to_string(i));
+			DiffInto(*elementA(i), *elementB(i), path, patch);
+			path.resize(length);
+		}
+		for (auto i = endA; i > common; i--)
+		{
+			AppendToken(path, std::to_string(i - 1));
+			AddOperation(patch, "remove", path);
+			path.resize(length);
+		}
+		for (auto i = common; i < endB; i++)
+		{
+			AppendToken(path, std::to_string(i));
+			AddOperation(patch, "add", path).Set("value", *elementB(i));
+			path.resize(length);
+		}
+		return;
+	}
+	if (!Identical(a, b))
+		AddOperation(patch, "replace", path).Set("value", b);
 }
 
-Json Json::JArray(std::initializer_list<const Json> args)
+//Equal with the same types all the way down, so that a diff turns 1 into 1.0 even though the two compare equal
+bool Json::Identical(const Json& a, const Json& b)
 {
-	Json result(Type::Array);
-	for (const auto& arg: args)
+	const auto type = a.GetType();
+	if (type != b.GetType())
+		return false;
+	if (type == Type::Object)
 	{
-		result.Add(arg);
+		const ObjectStorage& objectA = *a.var_.objectVal;
+		const ObjectStorage& objectB = *b.var_.objectVal;
+		if (objectA.size() != objectB.size())
+			return false;
+		for (const auto& entry : objectA)
+		{
+			const auto other = objectB.Find(entry.first);
+			if (!other || !Identical(entry.second, *other))
+				return false;
+		}
+		return true;
 	}
-	return result;
+	if (type == Type::Array)
+	{
+		const ArrayStorage& arrayA = *a.var_.arrayVal;
+		const ArrayStorage& arrayB = *b.var_.arrayVal;
+		if (arrayA.size() != arrayB.size())
+			return false;
+		for (auto elementA = arrayA.begin(), elementB = arrayB.begin(); elementA != arrayA.end(); ++elementA, ++elementB)
+		{
+			if (!Identical(*elementA, *elementB))
+				return false;
+		}
+		return true;
+	}
+	return a == b;
 }
 
-size_t Json::FindExt(const std::string& text, const std::string& delimiter)
+namespace
 {
-	for (size_t i = 0; i < text.length(); i++)
+	uint64_t Mix(uint64_t bits)
 	{
-		bool bResult = true;
-		const auto ch1 = text[i];
-		const auto ch2 = delimiter[0];
-		if (ch1 != ch2)
-			continue;
-		for (size_t j = 0, r = i; j < delimiter.length() || r < text.length(); j++, r++)
+		bits ^= bits >> 30;
+		bits *= 0xBF58476D1CE4E5B9ULL;
+		bits ^= bits >> 27;
+		bits *= 0x94D049BB133111EBULL;
+		return bits ^ (bits >> 31);
+	}
+
+	//Whether a real is a whole number within int64_t's range, which 2^63 is the first double past
+	bool IsWhole(const double val, int64_t& whole)
+	{
+		if (!(val >= -9223372036854775808.0 && val < 9223372036854775808.0) || std::trunc(val) != val)
+			return false;
+		whole = (int64_t)val;
+		return true;
+	}
+}
+
+uint64_t Json::Hash() const
+{
+	const auto type = GetType();
+	switch (type)
+	{
+	case Type::Null:	return Mix(1);
+	case Type::Bool:	return Mix(2 + var_.boolVal);
+	case Type::String:	return Mix(std::hash<std::string_view>()(var_.Str()) ^ 4);
+	case Type::Array:
+	case Type::Object:
+		break;
+	default:
+	{
+		//Equal numbers hash alike whichever type holds them: whole ones as integers, -0 included, the rest by their bits
+		int64_t whole = var_.AsInt64();
+		if (type == Type::Float || type == Type::Double)
 		{
-			const auto chA = delimiter[j];
-			const auto chB = text[r];
-			if (chA != chB)
+			const double val = var_.AsDouble();
+			if (!IsWhole(val, whole))
 			{
-				bResult = false;
-				i = r-1;
-				break;
+				uint64_t bits;
+				memcpy(&bits, &val, sizeof(bits));
+				return Mix(bits ^ (5ULL << 32));
 			}
 		}
-		if (!bResult)
-			continue;
-		return i;
+		return Mix((uint64_t)whole ^ (3ULL << 32));
 	}
-	return 0;
+	}
+
+	if (const auto cached = var_.CachedHash())
+		return cached;
+	uint64_t hash{ 0 };
+	if (type == Type::Array)
+	{
+		hash = 5;
+		var_.arrayVal->ForEach([&hash](const Json& element) { hash = Mix(hash + element.Hash()); });
+	}
+	else
+	{
+		//Equal objects can hold their keys in different orders, so the members are summed up
+		for (const auto& entry : *var_.objectVal)
+			hash += Mix(entry.first.Hash() + 0x9E3779B97F4A7C15ULL * entry.second.Hash());
+		hash = Mix(hash ^ 6);
+	}
+	hash += hash == 0;
+	if (var_.IsShared())
+		var_.Count().hash.store(hash, std::memory_order_relaxed);
+	return hash;
 }
 
-void Json::Save(const std::string& path)
+Json& Json::AddOperation(Json& patch, const char* op, std::string_view path)
 {
-	std::ofstream os;
-	std::string newPath = path;
-	if (!Json::FindExt(newPath, ".json"))
-		newPath += ".json";
-	os.open(newPath);
-	assert(os.is_open());
-	const auto& ref = (*this).Stringify();
-	os.write(ref.c_str(), strlen(ref.c_str()));
-	os.close();
+	auto& operation = patch.Add(Json(Type::Object));
+	operation.Set("op", op);
+	operation.Set("path", std::string(path));
+	return operation;
 }
 
-Json Json::Load(const std::string& path)
+void Json::AppendToken(std::string& path, std::string_view key)
 {
-	std::ifstream is;
-	is.open(path);
-	assert(is.is_open());
-	std::string buffer{ "" };
-	std::string text{ "" };
-	while (!is.eof())
+	path.push_back('/');
+	for (const auto ch : key)
 	{
-		std::getline(is, buffer);
-		text += buffer;
+		if (ch == '~')
+			path.append("~0", 2);
+		else if (ch == '/')
+			path.append("~1", 2);
+		else
+			path.push_back(ch);
 	}
-	is.close();
-	return Json::Parse(text);
 }
 
-void Json::Print() const
+//Paths in a patch are JSON Pointers only, Path would also take dotted ones
+bool Json::IsPointer(const Json& path)
 {
-	std::string Text{ "" }; size_t nextOff{ 2 };
-	switch (GetType())
+	if (path.GetType() != Type::String)
+		return false;
+	const auto text = path.GetString();
+	return text.empty() || text[0] == '/';
+}
+
+bool Json::ApplyPatch(const Json& patch)
+{
+	return ApplyPatch(Clone(patch, var_.Resource()));
+}
+
+bool Json::ApplyPatch(Json&& patch)
+{
+	if (patch.GetType() != Type::Array)
+		return false;
+	const auto resource = var_.Resource();
+	//Values are only moved out of operations nothing else holds
+	patch.var_.Detach();
+	for (auto& operation : *patch.var_.arrayVal)
 	{
-	case Type::Null:
-		Text += "null";
-		break;
-	case Type::Int:
-		Text += std::to_string(var_->intVal);
-		break;
-	case Type::Float:
-		Text += std::to_string(var_->floatVal);
-		break;
-	case Type::Bool:
-		Text += var_->boolVal ? "true" : "false";
-		break;
-	case Type::String:
-		Text += '\"' + *var_->stringVal + '\"';
-		break;
-	case Type::Array:
-		Text += "[\n";
-		for (const auto& val: *this)
-		{ 
-			Text += "  ";
-			Json::PrintS(Text, nextOff, val.Value());
-			Text += ",\n";
+		if (operation.GetType() != Type::Object)
+			return false;
+		operation.var_.Detach();
+		const auto& entries = *operation.var_.objectVal;
+		const auto op = entries.Find(std::string_view("op"));
+		const auto pointer = entries.Find(std::string_view("path"));
+		auto value = operation.var_.objectVal->Find(std::string_view("value"));
+		const auto from = entries.Find(std::string_view("from"));
+		if (!op || !pointer || !IsPointer(*pointer))
+			return false;
+		const Path path(pointer->GetString());
+		const auto name = op->GetString();
+
+		if (name == "test")
+		{
+			const auto target = static_cast<const Json*>(this)->Find(path);
+			if (!value || !target || *target != *value)
+				return false;
+			continue;
 		}
-		Text.pop_back();
-		Text.pop_back();
-		Text += "\n]";
-		break;
-	case Type::Object:
-		Text += "{\n";
-		for (const auto& val : *this)
+		if (name == "remove")
 		{
-			Text += "  \"" + val.Key() + '\"' + ": ";
-			Json::PrintS(Text, nextOff, val.Value());
-			Text += ",\n";
+			if (!RemoveAt(path, nullptr))
+				return false;
+			continue;
 		}
-		Text.pop_back();
-		Text.pop_back();
-		Text += "\n}";
-		break;
-	default:
-		break;
+		if (name == "move" || name == "copy")
+		{
+			if (!from || !IsPointer(*from))
+				return false;
+			const Path source(from->GetString());
+			Json taken;
+			if (name == "copy")
+			{
+				const auto found = static_cast<const Json*>(this)->Find(source);
+				if (!found)
+					return false;
+				taken = Clone(*found, resource);
+			}
+			else
+			{
+				//A value cannot be moved into one of its own members
+				const auto prefix = from->GetString();
+				const auto target = pointer->GetString();
+				if (target.length() > prefix.length() && target.compare(0, prefix.length(), prefix) == 0 && target[prefix.length()] == '/')
+					return false;
+				if (!RemoveAt(source, &taken))
+					return false;
+			}
+			if (!AddAt(path, std::move(taken)))
+				return false;
+			continue;
+		}
+		if (!value)
+			return false;
+		Json adopted = value->var_.Resource() == resource ? std::move(*value) : Clone(*value, resource);
+		if (name == "add")
+		{
+			if (!AddAt(path, std::move(adopted)))
+				return false;
+		}
+		else if (name == "replace")
+		{
+			const auto target = Find(path);
+			if (!target)
+				return false;
+			if (var_.IsShared())
+				adopted.Share();
+			*target = std::move(adopted);
+		}
+		else
+			return false;
 	}
-	std::cout << Text << std::endl;
+	return true;
 }
 
-void Json::PrintS(std::string& text, size_t& offset, const Json& json)
+bool Json::AddAt(const Path& path, Json&& value)
 {
-	size_t off = offset;
-	size_t nextOffset = off + 2;
-	switch (json.GetType())
+	if (path.Size() == 0)
 	{
-	case Type::Null:
-		text += "null";
+		*this = std::move(value);
+		return true;
+	}
+	const auto parent = Resolve(path, path.Size() - 1);
+	if (!parent)
+		return false;
+	const auto last = path.Size() - 1;
+	const auto key = path.Key(last);
+	switch (parent->GetType())
+	{
+	case Type::Object:
+		parent->var_.Detach();
+		if (parent->var_.IsShared())
+			value.Share();
+		parent->var_.objectVal->InsertOrAssign(key, std::move(value));
+		return true;
+	case Type::Array:
+	{
+		const auto size = parent->var_.arrayVal->size();
+		const auto index = key == "-" ? size : path.segments[last].index;
+		if (index > size)
+			return false;
+		parent->Insert(std::move(value), index);
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+//Takes the value out of its parent, moving it into removed when asked for
+bool Json::RemoveAt(const Path& path, Json* removed)
+{
+	if (path.Size() == 0)
+	{
+		if (removed)
+			*removed = std::move(*this);
+		*this = Json();
+		return true;
+	}
+	const auto last = path.Size() - 1;
+	const auto parent = Resolve(path, last);
+	if (!parent || !parent->Child(path, last))
+		return false;
+	parent->var_.Detach();
+	if (parent->GetType() == Type::Object)
+	{
+		const auto key = path.Key(last);
+		if (removed)
+			*removed = std::move(*parent->var_.objectVal->Find(key));
+		return parent->var_.objectVal->Erase(key);
+	}
+	auto removedValue = parent->var_.arrayVal->Remove(path.segments[last].index);
+	if (removed)
+		*removed = std::move(removedValue);
+	return true;
+}
+
+//Copies of a shared node hold the same storage
+const bool Json::Compare(const std::vector<Json>& a, const std::vector<Json>& b)
+{
+	return a == b;
+}
+
+const bool Json::Compare(const std::map<std::string, Json>& a, const std::map<std::string, Json>& b)
+{
+	return a == b;
+}
+
+const bool Json::Compare(const ArrayStorage& a, const ArrayStorage& b)
+{
+	if (&a == &b)
+		return true;
+	if (a.size() != b.size())
+		return false;
+	if (a.GetPacking() == Type::Null && b.GetPacking() == Type::Null)
+	{
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (a[i] != b[i])
+				return false;
+		}
+		return true;
+	}
+	//Packed numbers are only looked at by value, so that comparing does not build their elements
+	if (a.GetPacking() == Type::Float && a.Numbers<float>() && b.Numbers<float>())
+		return std::equal(a.Numbers<float>(), a.Numbers<float>() + a.size(), b.Numbers<float>());
+	if (a.GetPacking() == Type::Double && a.Numbers<double>() && b.Numbers<double>())
+		return std::equal(a.Numbers<double>(), a.Numbers<double>() + a.size(), b.Numbers<double>());
+	if (a.GetPacking() == Type::Int && a.Numbers<int>() && b.Numbers<int>())
+		return std::equal(a.Numbers<int>(), a.Numbers<int>() + a.size(), b.Numbers<int>());
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (a.Get(i) != b.Get(i))
+			return false;
+	}
+	return true;
+}
+
+const bool Json::Compare(const ObjectStorage& a, const ObjectStorage& b)
+{
+	if (&a == &b)
+		return true;
+	if (a.size() != b.size())
+		return false;
+	for (const auto& entry : a)
+	{
+		const auto bVal = b.Find(entry.first);
+		if (!bVal || entry.second != *bVal)
+			return false;
+	}
+	return true;
+}
+
+const Json::Type Json::GetType() const
+{
+	return (Type)var_.type;
+}
+
+const size_t Json::Size() const
+{
+	switch (GetType())
+	{
+	case Type::Array:
+		return var_.arrayVal->size();
+	case Type::Object:
+		return var_.objectVal->size();
+	default:
+		return 0;
+	}
+}
+
+Json& Json::Set(const std::string& key, const Json& value)
+{
+	assert(GetType() == Type::Object);
+	var_.Detach();
+	auto clone = Clone(value, var_.Resource());
+	if (var_.IsShared())
+		clone.Share();
+	return var_.objectVal->InsertOrAssign(key, std::move(clone));
+}
+
+bool Json::Contains(const std::string& key) const
+{
+	if (GetType() != Object)
+		return false;
+	return var_.objectVal->Find(key) != nullptr;
+}
+
+Json Json::JObject(std::initializer_list<std::pair<const std::string, const Json>> args)
+{
+	Json result(Json::Type::Object);
+	for (const auto &arg : args)
+	{ 
+		result.Set(arg.first, arg.second);
+	}
+	return result;
+}
+
+Json Json::JArray(std::initializer_list<const Json> args)
+{
+	Json result(Type::Array);
+	for (const auto& arg: args)
+	{
+		result.Add(arg);
+	}
+	return result;
+}
+
+size_t Json::FindExt(const std::string& text, const std::string& delimiter)
+{
+	for (size_t i = 0; i < text.length(); i++)
+	{
+		bool bResult = true;
+		const auto ch1 = text[i];
+		const auto ch2 = delimiter[0];
+		if (ch1 != ch2)
+			continue;
+		for (size_t j = 0, r = i; j < delimiter.length() || r < text.length(); j++, r++)
+		{
+			const auto chA = delimiter[j];
+			const auto chB = text[r];
+			if (chA != chB)
+			{
+				bResult = false;
+				i = r-1;
+				break;
+			}
+		}
+		if (!bResult)
+			continue;
+		return i;
+	}
+	return 0;
+}
+
+void Json::Save(const std::string& path, const Format format) const
+{
+	const std::string extension = format == Format::MessagePack ? ".msgpack" : ".json";
+	std::string newPath = path;
+	if (!Json::FindExt(newPath, extension))
+		newPath += extension;
+	std::ofstream os(newPath, std::ios::binary);
+	assert(os.is_open());
+	if (format == Format::Text)
+	{
+		Writer(os).Write(*this);
+		return;
+	}
+	const auto data = ToMessagePack();
+	os.write(data.data(), (std::streamsize)data.length());
+}
+
+Json Json::Load(const std::string& path, const LoadMode mode, const Format format)
+{
+	const MappedFile file(path, mode == LoadMode::Mapped);
+	assert(file.IsOpen());
+	if (!file.IsOpen())
+		return Json();
+	if (format == Format::MessagePack)
+		return FromMessagePack(file.View());
+	return Json::Parse(file.Data(), file.Size());
+}
+
+void Json::Print() const
+{
+	Writer(std::cout, true).Write(*this).Flush();
+	std::cout << std::endl;
+}
+
+auto Json::begin() const -> Iterator
+{
+	if (GetType() == Json::Type::Array)
+		return Iterator(this, static_cast<const ArrayStorage*>(var_.arrayVal)->begin());
+	else
+		return Iterator(this, static_cast<const ObjectStorage*>(var_.objectVal)->begin());
+}
+
+auto Json::end() const -> Iterator
+{
+	if (GetType() == Json::Type::Array)
+		return Iterator(this, static_cast<const ArrayStorage*>(var_.arrayVal)->end());
+	else
+		return Iterator(this, static_cast<const ObjectStorage*>(var_.objectVal)->end());
+}
+
+const std::string Json::Stringify() const
+{
+	std::string result;
+	Writer(result).Write(*this);
+	return result;
+}
+
+//Either text written while planning, or a range of a container's members that a worker serializes into text
+struct Json::StringifyPiece
+{
+	std::string text;
+	const Json* container = nullptr;
+	size_t begin{ 0 };
+	size_t end{ 0 };
+};
+
+const std::string Json::Stringify(const ParallelOptions& options) const
+{
+	auto pieces = StringifyPieces(options);
+	if (pieces.size() == 1)
+		return std::move(pieces.front().text);
+	size_t length{ 0 };
+	for (const auto& piece : pieces)
+		length += piece.text.length();
+	std::string result;
+	result.reserve(length);
+	for (const auto& piece : pieces)
+		result.append(piece.text);
+	return result;
+}
+
+void Json::Save(const std::string& path, const ParallelOptions& options) const
+{
+	if (options.threads == 1)
+		return Save(path);
+	std::string newPath = path;
+	if (!Json::FindExt(newPath, ".json"))
+		newPath += ".json";
+	std::ofstream os(newPath, std::ios::binary);
+	assert(os.is_open());
+	//Pieces are far larger than the stream's buffer, so each goes straight to the file
+	for (const auto& piece : StringifyPieces(options))
+		os.write(piece.text.data(), (std::streamsize)piece.text.length());
+}
+
+std::vector<Json::StringifyPiece> Json::StringifyPieces(const ParallelOptions& options) const
+{
+	const auto threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+	std::vector<StringifyPiece> pieces;
+	std::string literal;
+	{
+		Writer writer(literal);
+		if (threads == 1)
+			writer.Write(*this);
+		else
+			//A few ranges per thread even out members of different sizes
+			PlanPieces(writer, literal, pieces, threads * 4, 2 * std::max<size_t>(options.chunkSize, 1));
+	}
+	pieces.push_back({ std::move(literal) });
+	if (pieces.size() == 1)
+		return pieces;
+
+	std::atomic<size_t> next{ 0 };
+	const auto work = [&pieces, &next]
+	{
+		for (auto i = next.fetch_add(1); i < pieces.size(); i = next.fetch_add(1))
+		{
+			auto& piece = pieces[i];
+			if (piece.container)
+				Writer(piece.text).WriteRange(*piece.container, piece.begin, piece.end);
+		}
+	};
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < std::min<size_t>(threads, pieces.size()); i++)
+		workers.emplace_back(work);
+	work();
+	for (auto& worker : workers)
+		worker.join();
+	return pieces;
+}
+
+//Writes small values into literal and descends through containers with too few members to go around, so that a big array
+//under a key or two still gets split. A container with enough members is cut into ranges, and literal starts over after it
+void Json::PlanPieces(Writer& writer, std::string& literal, std::vector<StringifyPiece>& pieces, const size_t ranges, const size_t minSize) const
+{
+	const auto type = GetType();
+	if ((type != Type::Array && type != Type::Object) || EstimateSize(minSize) < minSize)
+	{
+		writer.Write(*this);
+		return;
+	}
+	const bool bObject = type == Type::Object;
+	if (bObject)
+		writer.StartObject();
+	else
+		writer.StartArray();
+	const auto count = Size();
+	if (count < ranges)
+	{
+		if (bObject)
+			for (const auto& entry : *var_.objectVal)
+			{
+				writer.Key(entry.first);
+				entry.second.PlanPieces(writer, literal, pieces, ranges, minSize);
+			}
+		else
+			var_.arrayVal->ForEach([&](const Json& val) { val.PlanPieces(writer, literal, pieces, ranges, minSize); });
+	}
+	else
+	{
+		pieces.push_back({ std::move(literal) });
+		literal.clear();
+		for (size_t i = 0; i < ranges; i++)
+			pieces.push_back({ std::string(), this, count * i / ranges, count * (i + 1) / ranges });
+		writer.levels.back() = count;
+	}
+	if (bObject)
+		writer.EndObject();
+	else
+		writer.EndArray();
+}
+
+//Rough length of the text, giving up soon after it passes limit
+size_t Json::EstimateSize(const size_t limit) const
+{
+	size_t size{ 2 };
+	switch (GetType())
+	{
+	case Type::String:
+		return var_.Str().length() + 2;
+	case Type::Array:
+		//Packed numbers are taken to be about as long as the first one
+		if (var_.arrayVal->GetPacking() != Type::Null)
+			return size + Size() * (var_.arrayVal->Get(0).EstimateSize(limit) + 1);
+		for (const auto& val : *static_cast<const ArrayStorage*>(var_.arrayVal))
+		{
+			if (size > limit)
+				break;
+			size += val.EstimateSize(limit - size) + 1;
+		}
+		return size;
+	case Type::Object:
+		for (const auto& entry : *var_.objectVal)
+		{
+			if (size > limit)
+				break;
+			size += entry.first.View().length() + entry.second.EstimateSize(limit - size) + 4;
+		}
+		return size;
+	default:
+		return 8;
+	}
+}
+
+template<typename Sink>
+class Json::Parser
+{
+public:
+	Parser(const char* begin, const char* end, Sink& sink);
+	bool ParseDocument();
+	//Steps through the members of the object or array that makes up the input without parsing them,
+	//handing visit each member's key (empty in arrays) and text
+	template<typename Visit>
+	bool ScanMembers(Visit&& visit);
+	//Parses a run of members split off from the inside of an array or object as if it were that whole container
+	bool ParseRun(const bool bObject);
+	//Parses a key, or a string, number or literal value, that makes up the whole input
+	bool ParseToken(const bool bKey);
+	//Steps for Reader, each skipping the whitespace in front of what it takes
+	bool PullValue();
+	bool PullKey(std::string_view& key);
+	bool PullChar(const char ch);
+	bool PullSkip();
+	bool PullEnd();
+
+private:
+	bool ParseValue();
+	bool ParseObject();
+	bool ParseArray();
+	bool ParseString(std::string_view& result);
+	bool ParseNumber();
+	bool ParseLiteral(const char* literal, const size_t length);
+	bool ParseHex4(unsigned& codePoint);
+	void SkipWS();
+	void SkipSpaceRun();
+	void SkipStringRun();
+	bool SkipString();
+	bool SkipValue();
+	static void AppendUtf8(std::string& text, const unsigned codePoint);
+	static bool IsDigit(const char ch) { return ch >= '0' && ch <= '9'; }
+	static bool IsSpace(const char ch) { return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t'; }
+	static bool Accumulate(const char ch, uint64_t& mantissa, int& digits);
+
+	//Inputs shorter than this are not worth setting up a structural index for, and strings are scanned this far before it is used
+	static constexpr size_t IndexThreshold = 4 * 1024;
+	static constexpr ptrdiff_t ShortString = 16;
+	//Any 19 digits fit in 64 bits, and integers up to 2^53 times or divided by a power of ten up to 1e22 are exact doubles
+	static constexpr int MaxDigits = 19;
+	static constexpr uint64_t MaxExactMantissa = 1ULL << 53;
+	static constexpr int MaxExactExponent = 22;
+
+	const char* cur;
+	const char* end;
+	Sink& sink;
+	std::string scratch;
+	std::optional<StructuralIndex> index;
+};
+
+template<typename Sink>
+Json::Parser<Sink>::Parser(const char* begin, const char* end, Sink& sink)
+	:cur(begin), end(end), sink(sink)
+{
+	if ((size_t)(end - begin) >= IndexThreshold)
+		index.emplace(begin, end);
+}
+
+template<typename Sink>
+bool Json::Parser<Sink>::ParseDocument()
+{
+	SkipWS();
+	if (!ParseValue())
+		return false;
+	SkipWS();
+	return cur == end;
+}
+
+template<typename Sink>
+template<typename Visit>
+bool Json::Parser<Sink>::ScanMembers(Visit&& visit)
+{
+	SkipWS();
+	if (cur == end || (*cur != '{' && *cur != '['))
+		return false;
+	const bool bObject = *cur++ == '{';
+	const char close = bObject ? '}' : ']';
+	SkipWS();
+	if (cur != end && *cur == close)
+	{
+		cur++;
+		SkipWS();
+		return cur == end;
+	}
+	while (true)
+	{
+		std::string_view key;
+		if (bObject)
+		{
+			if (cur == end || *cur != '"' || !ParseString(key))
+				return false;
+			SkipWS();
+			if (cur == end || *cur != ':')
+				return false;
+			cur++;
+			SkipWS();
+		}
+		const char* begin = cur;
+		if (!SkipValue())
+			return false;
+		visit(key, std::string_view(begin, cur - begin));
+		SkipWS();
+		if (cur == end)
+			return false;
+		if (*cur == close)
+		{
+			cur++;
+			SkipWS();
+			return cur == end;
+		}
+		if (*cur++ != ',')
+			return false;
+		SkipWS();
+	}
+}
+
+template<typename Sink>
+bool Json::Parser<Sink>::ParseRun(const bool bObject)
+{
+	if (!(bObject ? sink.StartObject() : sink.StartArray()))
+		return false;
+	SkipWS();
+	while (cur != end)
+	{
+		if (bObject)
+		{
+			std::string_view key;
+			if (*cur != '"' || !ParseString(key) || !sink.Key(key))
+				return false;
+			SkipWS();
+			if (cur == end || *cur != ':')
+				return false;
+			cur++;
+			SkipWS();
+		}
+		if (!ParseValue())
+			return false;
+		SkipWS();
+		if (cur == end)
+			break;
+		if (*cur != ',')
+			return false;
+		cur++;
+		SkipWS();
+		if (cur == end)
+			return false;
+	}
+	return bObject ? sink.EndObject() : sink.EndArray();
+}
+
+template<typename Sink>
+bool Json::Parser<Sink>::ParseToken(const bool bKey)
+{
+	if (bKey)
+	{
+		std::string_view key;
+		if (cur == end || *cur != '"' || !ParseString(key) || !sink.Key(key))
+			return false;
+	}
+	else if (!ParseValue())
+		return false;
+	return cur == end;
+}
+
+template<typename Sink>
+bool Json::Parser<Sink>::PullValue()
+{
+	SkipWS();
+	return ParseValue();
+}
+
+template<typename Sink>
+bool Json::Parser<Sink>::PullKey(std::string_view& key)
+{
+	SkipWS();
+	if (cur == end || *cur != '"' || !ParseString(key))
+		return false;
+	return PullChar(':');
+}
+
+template<typename Sink>
+bool Json::Parser<Sink>::PullChar(const char ch)
+{
+	SkipWS();
+	if (cur == end || *cur != ch)
+		return false;
+	cur++;
+	return true;
+}
+
+template<typename Sink>
+bool Json::Parser<Sink>::PullSkip()
+{
+	SkipWS();
+	return SkipValue();
+}
+
+template<typename Sink>
+bool Json::Parser<Sink>::PullEnd()
+{
+	SkipWS();
+	return cur == end;
+}
+
+template<typename Sink>
+inline void Json::Parser<Sink>::SkipWS()
+{
+	//Compact and single spaced input never gets past this
+	if (cur != end && IsSpace(*cur) && ++cur != end && IsSpace(*cur))
+		SkipSpaceRun();
+}
+
+template<typename Sink>
+void Json::Parser<Sink>::SkipSpaceRun()
+{
+	//The end of every whitespace run is indexed
+	if (index)
+		cur = index->Next(cur, false);
+	while (cur != end && IsSpace(*cur))
+		cur++;
+}
+
+template<typename Sink>
+bool Json::Parser<Sink>::ParseValue()
+{
+	if (cur == end)
+		return false;
+	switch (*cur)
+	{
+	case '{':
+		return ParseObject();
+	case '[':
+		return ParseArray();
+	case '"':
+	{
+		std::string_view str;
+		return ParseString(str) && sink.String(str);
+	}
+	case 't':
+		return ParseLiteral("true", 4) && sink.Bool(true);
+	case 'f':
+		return ParseLiteral("false", 5) && sink.Bool(false);
+	case 'n':
+		return ParseLiteral("null", 4) && sink.Null();
+	default:
+		return ParseNumber();
+	}
+}
+
+template<typename Sink>
+bool Json::Parser<Sink>::ParseObject()
+{
+	if (!sink.StartObject())
+		return false;
+	cur++;
+	SkipWS();
+	if (cur != end && *cur == '}')
+	{
+		cur++;
+		return sink.EndObject();
+	}
+	while (true)
+	{
+		std::string_view key;
+		if (cur == end || *cur != '"' || !ParseString(key) || !sink.Key(key))
+			return false;
+		SkipWS();
+		if (cur == end || *cur != ':')
+			return false;
+		cur++;
+		SkipWS();
+		if (!ParseValue())
+			return false;
+		SkipWS();
+		if (cur == end)
+			return false;
+		if (*cur == '}')
+		{
+			cur++;
+			return sink.EndObject();
+		}
+		if (*cur != ',')
+			return false;
+		cur++;
+		SkipWS();
+	}
+}
+
+template<typename Sink>
+bool Json::Parser<Sink>::ParseArray()
+{
+	if (!sink.StartArray())
+		return false;
+	cur++;
+	SkipWS();
+	if (cur != end && *cur == ']')
+	{
+		cur++;
+		return sink.EndArray();
+	}
+	while (true)
+	{
+		if (!ParseValue())
+			return false;
+		SkipWS();
+		if (cur == end)
+			return false;
+		if (*cur == ']')
+		{
+			cur++;
+			return sink.EndArray();
+		}
+		if (*cur != ',')
+			return false;
+		cur++;
+		SkipWS();
+	}
+}
+
+template<typename Sink>
+bool Json::Parser<Sink>::ParseString(std::string_view& result)
+{
+	const char* begin = ++cur;
+	const char* shortEnd = end - cur > ShortString ? cur + ShortString : end;
+	while (cur != shortEnd && *cur != '"' && *cur != '\\')
+		cur++;
+	if (cur == shortEnd)
+		SkipStringRun();
+	if (cur == end)
+		return false;
+	if (*cur == '"')
+	{
+		result = std::string_view(begin, cur++ - begin);
+		return true;
+	}
+
+	scratch.assign(begin, cur);
+	while (true)
+	{
+		const char* run = cur;
+		while (cur != end && *cur != '"' && *cur != '\\')
+			cur++;
+		scratch.append(run, cur);
+		if (cur == end)
+			return false;
+		if (*cur++ == '"')
+		{
+			result = scratch;
+			return true;
+		}
+		if (cur == end)
+			return false;
+		switch (*cur++)
+		{
+		case '"':	scratch.push_back('"'); break;
+		case '\\':	scratch.push_back('\\'); break;
+		case '/':	scratch.push_back('/'); break;
+		case 'b':	scratch.push_back('\b'); break;
+		case 'f':	scratch.push_back('\f'); break;
+		case 'n':	scratch.push_back('\n'); break;
+		case 'r':	scratch.push_back('\r'); break;
+		case 't':	scratch.push_back('\t'); break;
+		case 'u':
+		{
+			unsigned codePoint{ 0 };
+			if (!ParseHex4(codePoint))
+				return false;
+			if (codePoint >= 0xD800 && codePoint <= 0xDBFF)
+			{
+				unsigned low{ 0 };
+				if (end - cur < 2 || cur[0] != '\\' || cur[1] != 'u')
+					return false;
+				cur += 2;
+				if (!ParseHex4(low) || low < 0xDC00 || low > 0xDFFF)
+					return false;
+				codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+			}
+			else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF)
+				return false;
+			AppendUtf8(scratch, codePoint);
+			break;
+		}
+		default:
+			return false;
+		}
+	}
+}
+
+template<typename Sink>
+bool Json::Parser<Sink>::ParseHex4(unsigned& codePoint)
+{
+	if (end - cur < 4)
+		return false;
+	for (size_t i = 0; i < 4; i++)
+	{
+		const auto ch = *cur++;
+		codePoint <<= 4;
+		if (ch >= '0' && ch <= '9')
+			codePoint |= ch - '0';
+		else if (ch >= 'a' && ch <= 'f')
+			codePoint |= ch - 'a' + 10;
+		else if (ch >= 'A' && ch <= 'F')
+			codePoint |= ch - 'A' + 10;
+		else
+			return false;
+	}
+	return true;
+}
+
+template<typename Sink>
+void Json::Parser<Sink>::AppendUtf8(std::string& text, const unsigned codePoint)
+{
+	if (codePoint < 0x80)
+		text.push_back((char)codePoint);
+	else if (codePoint < 0x800)
+	{
+		text.push_back((char)(0xC0 | (codePoint >> 6)));
+		text.push_back((char)(0x80 | (codePoint & 0x3F)));
+	}
+	else if (codePoint < 0x10000)
+	{
+		text.push_back((char)(0xE0 | (codePoint >> 12)));
+		text.push_back((char)(0x80 | ((codePoint >> 6) & 0x3F)));
+		text.push_back((char)(0x80 | (codePoint & 0x3F)));
+	}
+	else
+	{
+		text.push_back((char)(0xF0 | (codePoint >> 18)));
+		text.push_back((char)(0x80 | ((codePoint >> 12) & 0x3F)));
+		text.push_back((char)(0x80 | ((codePoint >> 6) & 0x3F)));
+		text.push_back((char)(0x80 | (codePoint & 0x3F)));
+	}
+}
+
+template<typename Sink>
+void Json::Parser<Sink>::SkipStringRun()
+{
+	if (index)
+	{
+		//Nothing inside a string is indexed except backslashes, so the next position is its closing quote or first escape
+		const char* stop = index->Next(cur, true);
+		if (stop != end && (*stop == '"' || *stop == '\\'))
+			cur = stop;
+	}
+	while (cur != end && *cur != '"' && *cur != '\\')
+		cur++;
+}
+
+template<typename Sink>
+bool Json::Parser<Sink>::SkipString()
+{
+	cur++;
+	while (true)
+	{
+		const char* shortEnd = end - cur > ShortString ? cur + ShortString : end;
+		while (cur != shortEnd && *cur != '"' && *cur != '\\')
+			cur++;
+		if (cur == shortEnd)
+			SkipStringRun();
+		if (cur == end)
+			return false;
+		if (*cur++ == '"')
+			return true;
+		if (cur == end)
+			return false;
+		cur++;
+	}
+}
+
+template<typename Sink>
+bool Json::Parser<Sink>::SkipValue()
+{
+	//Only strings and nesting are followed, whatever is skipped gets validated when it is parsed
+	if (cur == end)
+		return false;
+	if (*cur == '"')
+		return SkipString();
+	if (*cur != '{' && *cur != '[')
+	{
+		const char* begin = cur;
+		while (cur != end && *cur != ',' && *cur != '}' && *cur != ']' && !IsSpace(*cur))
+			cur++;
+		return cur != begin;
+	}
+	static const auto nesting = []
+	{
+		std::array<bool, 256> table{};
+		for (const unsigned char ch : "\"{}[]")
+			table[ch] = ch != 0;
+		return table;
+	}();
+	size_t depth{ 0 };
+	while (true)
+	{
+		while (cur != end && !nesting[(unsigned char)*cur])
+			cur++;
+		if (cur == end)
+			return false;
+		switch (*cur)
+		{
+		case '"':
+			if (!SkipString())
+				return false;
+			continue;
+		case '{':
+		case '[':
+			depth++;
+			break;
+		default:
+			if (--depth == 0)
+			{
+				cur++;
+				return true;
+			}
+			break;
+		}
+		cur++;
+	}
+}
+
+template<typename Sink>
+bool Json::Parser<Sink>::Accumulate(const char ch, uint64_t& mantissa, int& digits)
+{
+	//Leading zeros are not significant and do not count towards the limit
+	if (digits == MaxDigits)
+		return false;
+	mantissa = mantissa * 10 + (uint64_t)(ch - '0');
+	if (mantissa != 0)
+		digits++;
+	return true;
+}
+
+template<typename Sink>
+bool Json::Parser<Sink>::ParseNumber()
+{
+	static constexpr double powers[MaxExactExponent + 1] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	//The digits are gathered while validating, numbers with too many of them for that are left to from_chars
+	const char* begin = cur;
+	bool bFloat = false;
+	bool bExact = true;
+	uint64_t mantissa{ 0 };
+	int digits{ 0 };
+	int exponent{ 0 };
+	const bool bNegative = cur != end && *cur == '-';
+	if (bNegative)
+		cur++;
+	if (cur == end || !IsDigit(*cur))
+		return false;
+	if (*cur == '0')
+		cur++;
+	else
+		for (; cur != end && IsDigit(*cur); cur++)
+			bExact = bExact && Accumulate(*cur, mantissa, digits);
+	if (cur != end && *cur == '.')
+	{
+		bFloat = true;
+		if (++cur == end || !IsDigit(*cur))
+			return false;
+		for (; cur != end && IsDigit(*cur); cur++, exponent--)
+			bExact = bExact && Accumulate(*cur, mantissa, digits);
+	}
+	if (cur != end && (*cur == 'e' || *cur == 'E'))
+	{
+		bFloat = true;
+		bool bNegativeExponent = false;
+		if (++cur != end && (*cur == '+' || *cur == '-'))
+			bNegativeExponent = *cur++ == '-';
+		if (cur == end || !IsDigit(*cur))
+			return false;
+		int written{ 0 };
+		for (; cur != end && IsDigit(*cur); cur++)
+			if (written < 10000)
+				written = written * 10 + (*cur - '0');
+		exponent += bNegativeExponent ? -written : written;
+	}
+
+	if (!bFloat && bExact)
+	{
+		if (mantissa <= (uint64_t)INT_MAX + bNegative)
+			return sink.Int(bNegative ? (int)(0 - mantissa) : (int)mantissa);
+		if (mantissa <= (uint64_t)INT64_MAX + bNegative)
+			return sink.Int64(bNegative ? (int64_t)(0 - mantissa) : (int64_t)mantissa);
+	}
+	if (bExact && mantissa <= MaxExactMantissa && exponent >= -MaxExactExponent && exponent <= MaxExactExponent)
+	{
+		auto val = (double)mantissa;
+		val = exponent < 0 ? val / powers[-exponent] : val * powers[exponent];
+		return sink.Double(bNegative ? -val : val);
+	}
+	double val{ 0.0 };
+	if (std::from_chars(begin, cur, val).ec != std::errc())
+		val = std::strtod(std::string(begin, cur).c_str(), nullptr);
+	return sink.Double(val);
+}
+
+template<typename Sink>
+bool Json::Parser<Sink>::ParseLiteral(const char* literal, const size_t length)
+{
+	if ((size_t)(end - cur) < length || memcmp(cur, literal, length) != 0)
+		return false;
+	cur += length;
+	return true;
+}
+
+class Json::DomBuilder final : public Json::Handler
+{
+public:
+	DomBuilder(Json& root, std::pmr::memory_resource* resource, const ObjectOrder order, std::string_view source = std::string_view());
+	~DomBuilder();
+	bool Null() override;
+	bool Bool(const bool bval) override;
+	bool Int(const int val) override;
+	bool Float(const float val) override;
+	bool Int64(const int64_t val) override;
+	bool Double(const double val) override;
+	bool String(std::string_view str) override;
+	bool StartObject() override;
+	bool Key(std::string_view key) override;
+	bool EndObject() override;
+	bool StartArray() override;
+	bool EndArray() override;
+
+private:
+	Json& Next();
+	bool Number(Json&& number);
+
+	Json& root;
+	std::pmr::memory_resource* resource;
+	ObjectOrder order;
+	std::vector<Json*> containers;
+	KeyPool parseKeys;
+	KeyPool* keys;
+	Json::Key key;
+	std::string_view source;
+};
+
+Json::DomBuilder::DomBuilder(Json& root, std::pmr::memory_resource* resource, const ObjectOrder order, std::string_view source)
+	:root(root), resource(resource), order(order), parseKeys(HeapResource(), true), keys(PoolOf(resource)), source(source)
+{
+	//Heap trees share one counted copy of each key for the length of the parse
+	if (!keys)
+		keys = &parseKeys;
+}
+
+Json::DomBuilder::~DomBuilder()
+{
+	key.Release();
+}
+
+Json& Json::DomBuilder::Next()
+{
+	if (containers.empty())
+		return root;
+	auto& top = containers.back()->var_;
+	if (top.type == Type::Array)
+		return top.arrayVal->emplace_back();
+	auto& value = top.objectVal->Append(key);
+	key = Json::Key();
+	return value;
+}
+
+//Numbers go into an array through Push, which keeps them packed while the array holds nothing else
+bool Json::DomBuilder::Number(Json&& number)
+{
+	if (!containers.empty() && containers.back()->var_.type == Type::Array)
+		containers.back()->var_.arrayVal->Push(std::move(number));
+	else
+		Next() = std::move(number);
+	return true;
+}
+
+bool Json::DomBuilder::Null()
+{
+	(void)Next();
+	return true;
+}
+
+bool Json::DomBuilder::Bool(const bool bval)
+{
+	auto& var = Next().var_;
+	var.type = Type::Bool;
+	var.boolVal = bval;
+	return true;
+}
+
+bool Json::DomBuilder::Int(const int val)
+{
+	return Number(Json(val));
+}
+
+bool Json::DomBuilder::Float(const float val)
+{
+	return Number(Json(val));
+}
+
+bool Json::DomBuilder::Int64(const int64_t val)
+{
+	return Number(Json(val));
+}
+
+bool Json::DomBuilder::Double(const double val)
+{
+	return Number(Json(val));
+}
+
+bool Json::DomBuilder::String(std::string_view str)
+{
+	auto& var = Next().var_;
+	//Strings without escapes come straight out of the input, the decoded ones are in the parser's scratch buffer
+	const bool bInSource = str.data() >= source.data() && str.data() < source.data() + source.length();
+	if (bInSource && str.length() > Var::ShortCapacity && str.length() <= UINT32_MAX)
+		var.SetBorrowed(str);
+	else
+		var.SetString(str, resource);
+	return true;
+}
+
+bool Json::DomBuilder::StartObject()
+{
+	auto& object = Next();
+	object.var_.Emplace(Type::Object, resource, order);
+	containers.push_back(&object);
+	return true;
+}
+
+bool Json::DomBuilder::Key(std::string_view key)
+{
+	this->key.Release();
+	this->key = keys->Intern(key);
+	return true;
+}
+
+bool Json::DomBuilder::EndObject()
+{
+	containers.back()->var_.objectVal->Finalize();
+	containers.pop_back();
+	return true;
+}
+
+bool Json::DomBuilder::StartArray()
+{
+	auto& array = Next();
+	array.var_.Emplace(Type::Array, resource);
+	containers.push_back(&array);
+	return true;
+}
+
+bool Json::DomBuilder::EndArray()
+{
+	containers.pop_back();
+	return true;
+}
+
+bool Json::ParseEvents(std::string_view js, Handler& handler)
+{
+	Parser<Handler> parser(js.data(), js.data() + js.length(), handler);
+	return parser.ParseDocument();
+}
+
+Json Json::Parse(const std::string& js)
+{
+	return Parse(js.data(), js.length());
+}
+
+Json Json::Parse(std::string_view js)
+{
+	return Parse(js.data(), js.length());
+}
+
+Json Json::Parse(const char* js)
+{
+	return Parse(js, strlen(js));
+}
+
+Json Json::Parse(const char* js, const size_t length)
+{
+	Json result;
+	(void)ParseInto(result, js, length, HeapResource());
+	return result;
+}
+
+//The split pass only follows strings and nesting with the structural classifier to find commas between members, the runs
+//between those are parsed by workers taking the next one from a shared counter, into heap trees whose members are then moved
+//into the result
+Json Json::Parse(std::string_view js, const ParallelOptions& options)
+{
+	const auto threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+	const auto chunkSize = std::max<size_t>(options.chunkSize, 1);
+	if (threads == 1 || js.length() < 2 * chunkSize)
+		return Parse(js);
+
+	struct Run
+	{
+		std::string_view text;
+		Json part;
+		bool bValid = false;
+	};
+	constexpr std::string_view spaces = " \t\n\r";
+	const auto open = js.find_first_not_of(spaces);
+	if (open == std::string_view::npos || (js[open] != '[' && js[open] != '{'))
+		return Parse(js);
+	const bool bObject = js[open] == '{';
+	std::vector<const char*> cuts;
+	const char* end = js.data() + js.length();
+	if (!StructuralIndex::SplitMembers(js.data() + open, end, chunkSize, cuts) || std::string_view(cuts.back() + 1, end - cuts.back() - 1).find_first_not_of(spaces) != std::string_view::npos)
+	{
+		assert(!"Json::Parse: malformed input");
+		return Json();
+	}
+	if (cuts.size() < 2)
+		return Parse(js);
+	std::vector<Run> runs;
+	const char* runBegin = js.data() + open + 1;
+	for (const char* cut : cuts)
+	{
+		runs.push_back({ std::string_view(runBegin, cut - runBegin), Json(), false });
+		runBegin = cut + 1;
+	}
+
+	std::atomic<size_t> next{ 0 };
+	const auto work = [&runs, &next, bObject]
+	{
+		for (auto i = next.fetch_add(1); i < runs.size(); i = next.fetch_add(1))
+		{
+			auto& run = runs[i];
+			DomBuilder builder(run.part, HeapResource(), DefaultObjectOrder);
+			Parser<DomBuilder> parser(run.text.data(), run.text.data() + run.text.length(), builder);
+			//A run that is only whitespace sat between two commas
+			run.bValid = parser.ParseRun(bObject) && run.part.Size();
+		}
+	};
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < std::min<size_t>(threads, runs.size()); i++)
+		workers.emplace_back(work);
+	work();
+	for (auto& worker : workers)
+		worker.join();
+
+	Json result = Make(bObject ? Type::Object : Type::Array, HeapResource());
+	size_t count{ 0 };
+	for (const auto& run : runs)
+	{
+		if (!run.bValid)
+		{
+			assert(!"Json::Parse: malformed input");
+			return Json();
+		}
+		count += run.part.Size();
+	}
+	if (!bObject)
+	{
+		auto& elements = *result.var_.arrayVal;
+		elements.reserve(count);
+		for (auto& run : runs)
+			elements.Append(std::move(*run.part.var_.arrayVal));
+		return result;
+	}
+	//Runs were finalized on their own, this puts their members in order and lets the last of a repeated key win across them
+	auto& members = *result.var_.objectVal;
+	members.reserve(count);
+	for (auto& run : runs)
+		for (auto& entry : *run.part.var_.objectVal)
+			members.Append(ShareKey(entry.first, nullptr)) = std::move(entry.second);
+	members.Finalize();
+	return result;
+}
+
+bool Json::ParseInto(Json& result, const char* js, const size_t length, std::pmr::memory_resource* resource, const ObjectOrder order, const bool bBorrow)
+{
+	if (TryParseInto(result, js, length, resource, order, bBorrow))
+		return true;
+	assert(!"Json::Parse: malformed input");
+	return false;
+}
+
+//For input where a malformed value is to be expected and dealt with
+bool Json::TryParseInto(Json& result, const char* js, const size_t length, std::pmr::memory_resource* resource, const ObjectOrder order, const bool bBorrow)
+{
+	result = Json();
+	DomBuilder builder(result, resource, order, bBorrow ? std::string_view(js, length) : std::string_view());
+	Parser<DomBuilder> parser(js, js + length, builder);
+	if (parser.ParseDocument())
+		return true;
+	result = Json();
+	return false;
+}
+
+namespace
+{
+	//MessagePack stores everything big endian behind a one byte tag
+	void PutTagged(std::string& out, const uint8_t tag, const uint64_t bits, const size_t size)
+	{
+		char bytes[9];
+		bytes[0] = (char)tag;
+		for (size_t i = 0; i < size; i++)
+			bytes[size - i] = (char)(bits >> (8 * i));
+		out.append(bytes, size + 1);
+	}
+
+	void PutInteger(std::string& out, const int64_t val)
+	{
+		if (val >= -32 && val <= INT8_MAX)
+			out.push_back((char)val);
+		else if (val >= INT8_MIN && val <= INT8_MAX)
+			PutTagged(out, 0xd0, (uint64_t)val, 1);
+		else if (val >= INT16_MIN && val <= INT16_MAX)
+			PutTagged(out, 0xd1, (uint64_t)val, 2);
+		else if (val >= INT32_MIN && val <= INT32_MAX)
+			PutTagged(out, 0xd2, (uint64_t)val, 4);
+		else
+			PutTagged(out, 0xd3, (uint64_t)val, 8);
+	}
+
+	//Strings, arrays and maps share the layout: a fix tag for small counts, then 8 (strings only), 16 and 32 bit counts
+	void PutLength(std::string& out, const uint8_t fixTag, const size_t fixLimit, const uint8_t tag8, const uint8_t tag16, const size_t length)
+	{
+		assert(length <= UINT32_MAX);
+		if (length < fixLimit)
+			out.push_back((char)(fixTag | length));
+		else if (tag8 && length <= UINT8_MAX)
+			PutTagged(out, tag8, length, 1);
+		else if (length <= UINT16_MAX)
+			PutTagged(out, tag16, length, 2);
+		else
+			PutTagged(out, tag16 + 1, length, 4);
+	}
+
+	void PutString(std::string& out, std::string_view str)
+	{
+		PutLength(out, 0xa0, 32, 0xd9, 0xda, str.length());
+		out.append(str.data(), str.length());
+	}
+}
+
+void Json::Pack(const Json& json, std::string& out)
+{
+	const auto& var = json.var_;
+	switch (json.GetType())
+	{
+	case Type::Null:
+		out.push_back((char)0xc0);
+		break;
+	case Type::Bool:
+		out.push_back((char)(var.boolVal ? 0xc3 : 0xc2));
+		break;
+	case Type::Int:
+		PutInteger(out, var.intVal);
+		break;
+	case Type::Int64:
+		PutInteger(out, var.int64Val);
+		break;
+	case Type::Float:
+	{
+		uint32_t bits;
+		memcpy(&bits, &var.floatVal, sizeof(bits));
+		PutTagged(out, 0xca, bits, sizeof(bits));
+		break;
+	}
+	case Type::Double:
+	{
+		uint64_t bits;
+		memcpy(&bits, &var.doubleVal, sizeof(bits));
+		PutTagged(out, 0xcb, bits, sizeof(bits));
+		break;
+	}
+	case Type::String:
+		PutString(out, var.Str());
+		break;
+	case Type::Array:
+		PutLength(out, 0x90, 16, 0, 0xdc, var.arrayVal->size());
+		var.arrayVal->ForEach([&out](const Json& val) { Pack(val, out); });
+		break;
+	case Type::Object:
+		PutLength(out, 0x80, 16, 0, 0xde, var.objectVal->size());
+		for (const auto& entry : *static_cast<const ObjectStorage*>(var.objectVal))
+		{
+			PutString(out, entry.first.View());
+			Pack(entry.second, out);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+//Builds a tree straight from MessagePack. Containers carry their counts up front, so every one is allocated at its final size.
+//Binary strings are read as strings, extension types are rejected.
+class Json::Unpacker
+{
+public:
+	Unpacker(const char* begin, const char* end, std::pmr::memory_resource* resource, const ObjectOrder order);
+	bool UnpackDocument(Json& root);
+
+private:
+	bool Unpack(Var& var);
+	bool UnpackString(Var& var, const size_t length);
+	bool UnpackArray(Var& var, const size_t count);
+	bool UnpackObject(Var& var, const size_t count);
+	bool ReadString(std::string_view& str);
+	bool ReadLength(const size_t size, size_t& length);
+	bool Read(const size_t size, uint64_t& bits);
+	static void SetInteger(Var& var, const int64_t val);
+
+	const char* cur;
+	const char* end;
+	std::pmr::memory_resource* resource;
+	ObjectOrder order;
+	KeyPool parseKeys;
+	KeyPool* keys;
+};
+
+Json::Unpacker::Unpacker(const char* begin, const char* end, std::pmr::memory_resource* resource, const ObjectOrder order)
+	:cur(begin), end(end), resource(resource), order(order), parseKeys(HeapResource(), true), keys(PoolOf(resource))
+{
+	if (!keys)
+		keys = &parseKeys;
+}
+
+bool Json::Unpacker::UnpackDocument(Json& root)
+{
+	return Unpack(root.var_) && cur == end;
+}
+
+bool Json::Unpacker::Unpack(Var& var)
+{
+	if (cur == end)
+		return false;
+	const auto tag = (uint8_t)*cur++;
+	if (tag <= 0x7f || tag >= 0xe0)
+	{
+		SetInteger(var, (int8_t)tag);
+		return true;
+	}
+	if ((tag & 0xe0) == 0xa0)
+		return UnpackString(var, tag & 0x1f);
+	if ((tag & 0xf0) == 0x90)
+		return UnpackArray(var, tag & 0x0f);
+	if ((tag & 0xf0) == 0x80)
+		return UnpackObject(var, tag & 0x0f);
+
+	uint64_t bits;
+	size_t length;
+	switch (tag)
+	{
+	case 0xc0:
+		var.type = Type::Null;
+		return true;
+	case 0xc2:
+	case 0xc3:
+		var.type = Type::Bool;
+		var.boolVal = tag == 0xc3;
+		return true;
+	case 0xca:
+	{
+		if (!Read(4, bits))
+			return false;
+		const auto single = (uint32_t)bits;
+		var.type = Type::Float;
+		memcpy(&var.floatVal, &single, sizeof(single));
+		return true;
+	}
+	case 0xcb:
+		if (!Read(8, bits))
+			return false;
+		var.type = Type::Double;
+		memcpy(&var.doubleVal, &bits, sizeof(bits));
+		return true;
+	case 0xcc:
+	case 0xcd:
+	case 0xce:
+	case 0xcf:
+		if (!Read((size_t)1 << (tag - 0xcc), bits))
+			return false;
+		if (bits > (uint64_t)INT64_MAX)
+		{
+			var.type = Type::Double;
+			var.doubleVal = (double)bits;
+		}
+		else
+			SetInteger(var, (int64_t)bits);
+		return true;
+	case 0xd0:
+	case 0xd1:
+	case 0xd2:
+	case 0xd3:
+	{
+		const size_t size = (size_t)1 << (tag - 0xd0);
+		if (!Read(size, bits))
+			return false;
+		//Sign extend from the stored width
+		const auto shift = 64 - 8 * size;
+		SetInteger(var, (int64_t)(bits << shift) >> shift);
+		return true;
+	}
+	case 0xc4:
+	case 0xc5:
+	case 0xc6:
+		return ReadLength((size_t)1 << (tag - 0xc4), length) && UnpackString(var, length);
+	case 0xd9:
+	case 0xda:
+	case 0xdb:
+		return ReadLength((size_t)1 << (tag - 0xd9), length) && UnpackString(var, length);
+	case 0xdc:
+	case 0xdd:
+		return ReadLength(tag == 0xdc ? 2 : 4, length) && UnpackArray(var, length);
+	case 0xde:
+	case 0xdf:
+		return ReadLength(tag == 0xde ? 2 : 4, length) && UnpackObject(var, length);
+	default:
+		return false;
+	}
+}
+
+bool Json::Unpacker::UnpackString(Var& var, const size_t length)
+{
+	if ((size_t)(end - cur) < length)
+		return false;
+	var.SetString(std::string_view(cur, length), resource);
+	cur += length;
+	return true;
+}
+
+bool Json::Unpacker::UnpackArray(Var& var, const size_t count)
+{
+	//Every element takes at least a byte, which bounds what a corrupt count can make us reserve
+	if ((size_t)(end - cur) < count)
+		return false;
+	var.Emplace(Type::Array, resource);
+	var.arrayVal->reserve(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		Json element;
+		if (!Unpack(element.var_))
+			return false;
+		var.arrayVal->Push(std::move(element));
+	}
+	return true;
+}
+
+bool Json::Unpacker::UnpackObject(Var& var, const size_t count)
+{
+	if ((size_t)(end - cur) / 2 < count)
+		return false;
+	var.Emplace(Type::Object, resource, order);
+	var.objectVal->reserve(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		std::string_view key;
+		if (!ReadString(key) || !Unpack(var.objectVal->Append(keys->Intern(key)).var_))
+			return false;
+	}
+	var.objectVal->Finalize();
+	return true;
+}
+
+bool Json::Unpacker::ReadString(std::string_view& str)
+{
+	if (cur == end)
+		return false;
+	const auto tag = (uint8_t)*cur++;
+	size_t length;
+	if ((tag & 0xe0) == 0xa0)
+		length = tag & 0x1f;
+	else if (tag < 0xd9 || tag > 0xdb || !ReadLength((size_t)1 << (tag - 0xd9), length))
+		return false;
+	if ((size_t)(end - cur) < length)
+		return false;
+	str = std::string_view(cur, length);
+	cur += length;
+	return true;
+}
+
+bool Json::Unpacker::ReadLength(const size_t size, size_t& length)
+{
+	uint64_t bits;
+	if (!Read(size, bits))
+		return false;
+	length = (size_t)bits;
+	return true;
+}
+
+bool Json::Unpacker::Read(const size_t size, uint64_t& bits)
+{
+	if ((size_t)(end - cur) < size)
+		return false;
+	bits = 0;
+	for (size_t i = 0; i < size; i++)
+		bits = bits << 8 | (uint8_t)cur[i];
+	cur += size;
+	return true;
+}
+
+void Json::Unpacker::SetInteger(Var& var, const int64_t val)
+{
+	if (val >= INT_MIN && val <= INT_MAX)
+	{
+		var.type = Type::Int;
+		var.intVal = (int)val;
+		return;
+	}
+	var.type = Type::Int64;
+	var.int64Val = val;
+}
+
+bool Json::UnpackInto(Json& result, const char* data, const size_t length, std::pmr::memory_resource* resource, const ObjectOrder order)
+{
+	result = Json();
+	Unpacker unpacker(data, data + length, resource, order);
+	if (unpacker.UnpackDocument(result))
+		return true;
+	assert(!"Json::FromMessagePack: malformed input");
+	result = Json();
+	return false;
+}
+
+const std::string Json::ToMessagePack() const
+{
+	std::string result;
+	Pack(*this, result);
+	return result;
+}
+
+Json Json::FromMessagePack(std::string_view data)
+{
+	Json result;
+	(void)UnpackInto(result, data.data(), data.length(), HeapResource());
+	return result;
+}
+
+Json::Document::Document(const size_t initialSize, const ObjectOrder order)
+	:arena(initialSize), order(order)
+{
+}
+
+Json& Json::Document::Parse(std::string_view js)
+{
+	(void)ParseInto(root, js.data(), js.length(), &arena, order);
+	return Root();
+}
+
+Json& Json::Document::Load(const std::string& path, const LoadMode mode, const Format format)
+{
+	const MappedFile file(path, mode == LoadMode::Mapped);
+	assert(file.IsOpen());
+	root = Json();
+	if (!file.IsOpen())
+		return Root();
+	if (format == Format::MessagePack)
+		(void)UnpackInto(root, file.Data(), file.Size(), &arena, order);
+	else
+		(void)ParseInto(root, file.Data(), file.Size(), &arena, order);
+	return Root();
+}
+
+Json& Json::Document::ParseBorrowed(std::string_view js)
+{
+	(void)ParseInto(root, js.data(), js.length(), &arena, order, true);
+	return Root();
+}
+
+Json& Json::Document::LoadBorrowed(const std::string& path, const LoadMode mode)
+{
+	auto file = std::make_shared<const MappedFile>(path, mode == LoadMode::Mapped);
+	assert(file->IsOpen());
+	root = Json();
+	if (file->IsOpen())
+		(void)ParseInto(root, file->Data(), file->Size(), &arena, order, true);
+	source = std::move(file);
+	return Root();
+}
+
+Json Json::Document::Create(const Type type)
+{
+	return Make(type, &arena, order);
+}
+
+Json& Json::Document::Root()
+{
+	return HandOut(root, &arena);
+}
+
+const Json& Json::Document::Root() const
+{
+	return root;
+}
+
+struct Json::LazyView::Node
+{
+	explicit Node(std::string_view text);
+	void Index() const;
+
+	std::string_view text;
+	mutable std::vector<Member> members;
+	mutable bool bIndexed = false;
+	mutable std::unique_ptr<Json> value;
+	std::shared_ptr<const MappedFile> file;
+};
+
+struct Json::LazyView::Member
+{
+	std::string key;
+	uint32_t hash;
+	Node node;
+};
+
+Json::LazyView::Node::Node(std::string_view text)
+	:text(text)
+{
+	const auto first = this->text.find_first_not_of(" \t\n\r");
+	this->text.remove_prefix(std::min(first, this->text.length()));
+	this->text.remove_suffix(this->text.length() - (this->text.find_last_not_of(" \t\n\r") + 1));
+}
+
+void Json::LazyView::Node::Index() const
+{
+	if (bIndexed)
+		return;
+	bIndexed = true;
+	Handler none;
+	Parser<Handler> parser(text.data(), text.data() + text.length(), none);
+	const bool bValid = parser.ScanMembers([this](std::string_view key, std::string_view member)
+	{
+		members.push_back(Member{ std::string(key), Key::HashOf(key), Node(member) });
+	});
+	if (bValid)
+		return;
+	assert(!"Json::LazyView: malformed input");
+	members.clear();
+}
+
+Json::LazyView::LazyView() = default;
+
+Json::LazyView::LazyView(std::string_view text)
+	:node(std::make_shared<const Node>(text))
+{
+}
+
+Json::LazyView::LazyView(std::shared_ptr<const Node> node)
+	:node(std::move(node))
+{
+}
+
+Json::LazyView Json::LazyView::Load(const std::string& path, const LoadMode mode)
+{
+	auto file = std::make_shared<const MappedFile>(path, mode == LoadMode::Mapped);
+	assert(file->IsOpen());
+	if (!file->IsOpen())
+		return LazyView();
+	auto root = std::make_shared<Node>(file->View());
+	root->file = std::move(file);
+	return LazyView(std::move(root));
+}
+
+Json::LazyView Json::LazyView::At(const size_t i) const
+{
+	//Members live inside the root's node, so a view of one keeps the whole tree alive
+	return LazyView(std::shared_ptr<const Node>(node, &node->members[i].node));
+}
+
+auto Json::LazyView::Find(std::string_view key) const -> const Node*
+{
+	node->Index();
+	//The last of repeated keys wins, like it does when parsing
+	const auto hash = Key::HashOf(key);
+	for (auto member = node->members.rbegin(); member != node->members.rend(); ++member)
+		if (member->hash == hash && member->key == key)
+			return &member->node;
+	return nullptr;
+}
+
+Json::LazyView Json::LazyView::operator[](std::string_view key) const
+{
+	//A key that is not there gets an empty view, which reads as null
+	if (GetType() != Type::Object)
+		return LazyView();
+	const auto member = Find(key);
+	return member ? LazyView(std::shared_ptr<const Node>(node, member)) : LazyView();
+}
+
+Json::LazyView Json::LazyView::operator[](const char* key) const
+{
+	return (*this)[std::string_view(key)];
+}
+
+Json::LazyView Json::LazyView::operator[](size_t i) const
+{
+	if (GetType() != Type::Array)
+		return LazyView();
+	node->Index();
+	return i < node->members.size() ? At(i) : LazyView();
+}
+
+Json::LazyView Json::LazyView::operator[](int i) const
+{
+	return i >= 0 ? (*this)[(size_t)i] : LazyView();
+}
+
+Json::LazyView::operator bool() const
+{
+	return Value();
+}
+
+Json::LazyView::operator int() const
+{
+	return Value();
+}
+
+Json::LazyView::operator float() const
+{
+	return Value();
+}
+
+Json::LazyView::operator int64_t() const
+{
+	return Value();
+}
+
+Json::LazyView::operator double() const
+{
+	return Value();
+}
+
+Json::LazyView::operator std::string() const
+{
+	return Value();
+}
+
+const Json::Type Json::LazyView::GetType() const
+{
+	if (!node || node->text.empty())
+		return Type::Null;
+	switch (node->text.front())
+	{
+	case '{':	return Type::Object;
+	case '[':	return Type::Array;
+	case '"':	return Type::String;
+	case 't':
+	case 'f':	return Type::Bool;
+	case 'n':	return Type::Null;
+	default:	return Value().GetType();
+	}
+}
+
+const size_t Json::LazyView::Size() const
+{
+	const auto type = GetType();
+	if (type != Type::Object && type != Type::Array)
+		return 0;
+	node->Index();
+	return node->members.size();
+}
+
+bool Json::LazyView::Contains(std::string_view key) const
+{
+	if (GetType() != Type::Object)
+		return false;
+	return Find(key) != nullptr;
+}
+
+std::string_view Json::LazyView::Text() const
+{
+	return node ? node->text : std::string_view();
+}
+
+const Json& Json::LazyView::Value() const
+{
+	//Never written to, so every empty view can hand out the same one
+	static const Json null;
+	if (!node)
+		return null;
+	if (!node->value)
+	{
+		node->value = std::make_unique<Json>();
+		if (!node->text.empty())
+			(void)ParseInto(*node->value, node->text.data(), node->text.length(), HeapResource());
+	}
+	return *node->value;
+}
+
+auto Json::LazyView::begin() const -> Iterator
+{
+	return Iterator(this, 0);
+}
+
+auto Json::LazyView::end() const -> Iterator
+{
+	return Iterator(this, Size());
+}
+
+Json::LazyView::Iterator::Iterator(const LazyView* view, const size_t index)
+	:view(view), index(index)
+{
+}
+
+Json::LazyView::Iterator* Json::LazyView::Iterator::operator++()
+{
+	index++;
+	return this;
+}
+
+bool Json::LazyView::Iterator::operator!=(const Iterator& other) const
+{
+	return index != other.index;
+}
+
+Json::LazyView::Iterator& Json::LazyView::Iterator::operator*()
+{
+	return *this;
+}
+
+std::string_view Json::LazyView::Iterator::Key() const
+{
+	return view->node->members[index].key;
+}
+
+Json::LazyView Json::LazyView::Iterator::Value() const
+{
+	return view->At(index);
+}
+
+struct Json::SnapshotHeader
+{
+	static constexpr uint32_t Magic = 0x504E534A;	//"JSNP" in a little endian file
+	static constexpr uint32_t Version = 1;
+
+	uint32_t magic;
+	uint32_t version;
+	uint64_t slotCount;
+	uint64_t stringsOffset;
+	uint64_t stringsSize;
+};
+
+struct Json::SnapshotSlot
+{
+	//Set on objects whose members are not in key order, a sorted permutation of them follows the members
+	static constexpr uint8_t SortedIndex = 1;
+
+	uint8_t type;
+	uint8_t flags;
+	uint16_t unused;
+	uint32_t count;		//String length or number of members
+	uint64_t value;		//Scalar bits, offset into the string area or position of the first member
+};
+
+//Lays a tree out as slots, depth first with the members of each container kept next to each other
+class Json::SnapshotBuilder
+{
+public:
+	explicit SnapshotBuilder(const Json& root);
+	void Write(std::ostream& os) const;
+
+private:
+	void Fill(const size_t index, const Json& json);
+	SnapshotSlot StringSlot(std::string_view str);
+	size_t Reserve(const size_t count);
+
+	std::vector<SnapshotSlot> slots;
+	std::string strings;
+	std::unordered_map<std::string_view, uint64_t> interned;
+};
+
+Json::SnapshotBuilder::SnapshotBuilder(const Json& root)
+{
+	Reserve(1);
+	Fill(0, root);
+}
+
+void Json::SnapshotBuilder::Write(std::ostream& os) const
+{
+	static_assert(sizeof(SnapshotSlot) == 16, "Snapshot slots are written as they are in memory");
+	SnapshotHeader header{ SnapshotHeader::Magic, SnapshotHeader::Version, slots.size(), sizeof(SnapshotHeader) + slots.size() * sizeof(SnapshotSlot), strings.length() };
+	os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	os.write(reinterpret_cast<const char*>(slots.data()), (std::streamsize)(slots.size() * sizeof(SnapshotSlot)));
+	os.write(strings.data(), (std::streamsize)strings.length());
+}
+
+void Json::SnapshotBuilder::Fill(const size_t index, const Json& json)
+{
+	const auto& var = json.var_;
+	SnapshotSlot slot{ (uint8_t)var.type, 0, 0, 0, 0 };
+	switch (json.GetType())
+	{
+	case Type::Bool:
+		slot.value = var.boolVal;
+		break;
+	case Type::Int:
+		slot.value = (uint64_t)(int64_t)var.intVal;
+		break;
+	case Type::Int64:
+		slot.value = (uint64_t)var.int64Val;
+		break;
+	case Type::Float:
+	{
+		uint32_t bits;
+		memcpy(&bits, &var.floatVal, sizeof(bits));
+		slot.value = bits;
+		break;
+	}
+	case Type::Double:
+		memcpy(&slot.value, &var.doubleVal, sizeof(slot.value));
+		break;
+	case Type::String:
+		slot = StringSlot(var.Str());
+		break;
+	case Type::Array:
+	{
+		const auto& array = *var.arrayVal;
+		assert(array.size() <= UINT32_MAX);
+		slot.count = (uint32_t)array.size();
+		slot.value = Reserve(array.size());
+		size_t i{ 0 };
+		array.ForEach([&](const Json& element) { Fill(slot.value + i++, element); });
+		break;
+	}
+	case Type::Object:
+	{
+		const auto& object = *static_cast<const ObjectStorage*>(var.objectVal);
+		assert(object.size() <= UINT32_MAX);
+		std::vector<std::string_view> keys;
+		keys.reserve(object.size());
+		for (const auto& entry : object)
+			keys.push_back(entry.first.View());
+		const bool bSorted = std::is_sorted(keys.begin(), keys.end());
+		const auto indexSlots = bSorted ? 0 : (keys.size() * sizeof(uint32_t) + sizeof(SnapshotSlot) - 1) / sizeof(SnapshotSlot);
+		slot.count = (uint32_t)keys.size();
+		slot.value = Reserve(2 * keys.size() + indexSlots);
+		if (!bSorted)
+		{
+			slot.flags |= SnapshotSlot::SortedIndex;
+			std::vector<uint32_t> order(keys.size());
+			std::iota(order.begin(), order.end(), 0);
+			std::sort(order.begin(), order.end(), [&keys](const uint32_t a, const uint32_t b) { return keys[a] < keys[b]; });
+			memcpy(&slots[slot.value + 2 * keys.size()], order.data(), order.size() * sizeof(uint32_t));
+		}
+		size_t i{ 0 };
+		for (const auto& entry : object)
+		{
+			slots[slot.value + 2 * i] = StringSlot(keys[i]);
+			Fill(slot.value + 2 * i + 1, entry.second);
+			i++;
+		}
+		break;
+	}
+	default:
+		break;
+	}
+	slots[index] = slot;
+}
+
+Json::SnapshotSlot Json::SnapshotBuilder::StringSlot(std::string_view str)
+{
+	assert(str.length() <= UINT32_MAX);
+	const auto found = interned.try_emplace(str, strings.length());
+	if (found.second)
+		strings.append(str.data(), str.length());
+	return SnapshotSlot{ Type::String, 0, 0, (uint32_t)str.length(), found.first->second };
+}
+
+size_t Json::SnapshotBuilder::Reserve(const size_t count)
+{
+	const auto first = slots.size();
+	slots.resize(first + count, SnapshotSlot{ Type::Null, 0, 0, 0, 0 });
+	return first;
+}
+
+void Json::WriteSnapshot(const std::string& path) const
+{
+	std::ofstream os(path, std::ios::binary);
+	assert(os.is_open());
+	SnapshotBuilder(*this).Write(os);
+}
+
+Json::SnapshotView Json::MapSnapshot(const std::string& path)
+{
+	auto file = std::make_shared<const MappedFile>(path, true);
+	assert(file->IsOpen());
+	if (!file->IsOpen() || file->Size() < sizeof(SnapshotHeader))
+		return SnapshotView();
+	const auto header = reinterpret_cast<const SnapshotHeader*>(file->Data());
+	const auto slotSpace = (file->Size() - sizeof(SnapshotHeader)) / sizeof(SnapshotSlot);
+	const bool bValid = header->magic == SnapshotHeader::Magic && header->version == SnapshotHeader::Version && header->slotCount != 0 &&
+		header->slotCount <= slotSpace && header->stringsOffset == sizeof(SnapshotHeader) + header->slotCount * sizeof(SnapshotSlot) &&
+		header->stringsSize == file->Size() - header->stringsOffset;
+	assert(bValid && "Json::MapSnapshot: not a snapshot");
+	if (!bValid)
+		return SnapshotView();
+	const auto root = reinterpret_cast<const SnapshotSlot*>(header + 1);
+	return SnapshotView(std::move(file), header, root);
+}
+
+Json::SnapshotView::SnapshotView() = default;
+
+Json::SnapshotView::SnapshotView(std::shared_ptr<const MappedFile> file, const SnapshotHeader* header, const SnapshotSlot* slot)
+	:file(std::move(file)), header(header), slot(slot)
+{
+}
+
+Json::SnapshotView Json::SnapshotView::Child(const SnapshotSlot* child) const
+{
+	if (!child)
+		return SnapshotView();
+	return SnapshotView(file, header, child);
+}
+
+const Json::SnapshotSlot* Json::SnapshotView::At(const uint64_t index) const
+{
+	//Positions are read from the file, ones out of range read as missing
+	if (index >= header->slotCount)
+		return nullptr;
+	return reinterpret_cast<const SnapshotSlot*>(header + 1) + index;
+}
+
+const Json::SnapshotSlot* Json::SnapshotView::MemberAt(const size_t i) const
+{
+	if (i >= Size())
+		return nullptr;
+	return GetType() == Type::Array ? At(slot->value + i) : At(slot->value + 2 * i + 1);
+}
+
+std::string_view Json::SnapshotView::KeyAt(const size_t i) const
+{
+	if (GetType() != Type::Object || i >= Size())
+		return std::string_view();
+	return StringOf(At(slot->value + 2 * i));
+}
+
+const Json::SnapshotSlot* Json::SnapshotView::Find(std::string_view key) const
+{
+	if (GetType() != Type::Object)
+		return nullptr;
+	const auto count = Size();
+	const uint32_t* order = nullptr;
+	if (slot->flags & SnapshotSlot::SortedIndex)
+	{
+		const auto index = At(slot->value + 2 * count + (count * sizeof(uint32_t) + sizeof(SnapshotSlot) - 1) / sizeof(SnapshotSlot) - 1);
+		if (!index)
+			return nullptr;
+		order = reinterpret_cast<const uint32_t*>(At(slot->value + 2 * count));
+	}
+	size_t low{ 0 }, high{ count };
+	while (low < high)
+	{
+		const auto mid = low + (high - low) / 2;
+		const size_t member = order ? order[mid] : mid;
+		const auto compare = KeyAt(member).compare(key);
+		if (compare == 0)
+			return MemberAt(member);
+		if (compare < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return nullptr;
+}
+
+std::string_view Json::SnapshotView::StringOf(const SnapshotSlot* string) const
+{
+	if (!string || string->type != Type::String || string->value > header->stringsSize || string->count > header->stringsSize - string->value)
+		return std::string_view();
+	return std::string_view(reinterpret_cast<const char*>(header) + header->stringsOffset + string->value, string->count);
+}
+
+Json::Var Json::SnapshotView::Scalar() const
+{
+	Var var;
+	switch (GetType())
+	{
+	case Type::Bool:
+		var.type = Type::Bool;
+		var.boolVal = slot->value != 0;
+		break;
+	case Type::Int:
+		var.type = Type::Int;
+		var.intVal = (int)(int64_t)slot->value;
+		break;
+	case Type::Int64:
+		var.type = Type::Int64;
+		var.int64Val = (int64_t)slot->value;
+		break;
+	case Type::Float:
+	{
+		const auto bits = (uint32_t)slot->value;
+		var.type = Type::Float;
+		memcpy(&var.floatVal, &bits, sizeof(bits));
+		break;
+	}
+	case Type::Double:
+		var.type = Type::Double;
+		memcpy(&var.doubleVal, &slot->value, sizeof(var.doubleVal));
+		break;
+	default:
+		break;
+	}
+	return var;
+}
+
+Json::SnapshotView Json::SnapshotView::operator[](std::string_view key) const
+{
+	//A key that is not there, or a view that is not an object, gets an empty view, which reads as null and can be indexed further
+	return Child(Find(key));
+}
+
+Json::SnapshotView Json::SnapshotView::operator[](const char* key) const
+{
+	return (*this)[std::string_view(key)];
+}
+
+Json::SnapshotView Json::SnapshotView::operator[](size_t i) const
+{
+	//Likewise for an index past the end or a view that is not an array
+	if (GetType() != Type::Array)
+		return SnapshotView();
+	return Child(MemberAt(i));
+}
+
+Json::SnapshotView Json::SnapshotView::operator[](int i) const
+{
+	return (*this)[(size_t)i];
+}
+
+Json::SnapshotView::operator bool() const
+{
+	const auto var = Scalar();
+	return var.type == Type::Bool && var.boolVal;
+}
+
+Json::SnapshotView::operator int() const
+{
+	return Scalar().AsInt();
+}
+
+Json::SnapshotView::operator float() const
+{
+	const auto var = Scalar();
+	if (var.type == Type::Float)
+		return var.floatVal;
+	return (float)var.AsDouble();
+}
+
+Json::SnapshotView::operator int64_t() const
+{
+	return Scalar().AsInt64();
+}
+
+Json::SnapshotView::operator double() const
+{
+	return Scalar().AsDouble();
+}
+
+Json::SnapshotView::operator std::string() const
+{
+	return std::string(GetString());
+}
+
+const Json::Type Json::SnapshotView::GetType() const
+{
+	if (!slot || slot->type > Type::Double)
+		return Type::Null;
+	return (Type)slot->type;
+}
+
+const size_t Json::SnapshotView::Size() const
+{
+	const auto type = GetType();
+	if (type != Type::Object && type != Type::Array)
+		return 0;
+	//Members always come after their container, which also rules out cycles in a damaged file
+	const auto position = (uint64_t)(slot - reinterpret_cast<const SnapshotSlot*>(header + 1));
+	const auto span = type == Type::Object ? 2 * (uint64_t)slot->count : slot->count;
+	if (slot->value <= position || slot->value > header->slotCount || span > header->slotCount - slot->value)
+		return 0;
+	return slot->count;
+}
+
+bool Json::SnapshotView::Contains(std::string_view key) const
+{
+	return Find(key) != nullptr;
+}
+
+std::string_view Json::SnapshotView::GetString() const
+{
+	return StringOf(slot);
+}
+
+Json Json::SnapshotView::Value() const
+{
+	Json result;
+	switch (GetType())
+	{
+	case Type::String:
+		result.var_.SetString(GetString(), HeapResource());
+		break;
+	case Type::Array:
+		result.var_.Emplace(Type::Array, HeapResource());
+		result.var_.arrayVal->reserve(Size());
+		for (const auto& member : *this)
+			result.var_.arrayVal->Push(member.Value().Value());
+		break;
+	case Type::Object:
+		result.var_.Emplace(Type::Object, HeapResource());
+		result.var_.objectVal->reserve(Size());
+		for (const auto& member : *this)
+			result.var_.objectVal->InsertOrAssign(member.Key(), member.Value().Value());
+		break;
+	default:
+		result.var_ = Scalar();
+		break;
+	}
+	return result;
+}
+
+auto Json::SnapshotView::begin() const -> Iterator
+{
+	return Iterator(this, 0);
+}
+
+auto Json::SnapshotView::end() const -> Iterator
+{
+	return Iterator(this, Size());
+}
+
+Json::SnapshotView::Iterator::Iterator(const SnapshotView* view, const size_t index)
+	:view(view), index(index)
+{
+}
+
+Json::SnapshotView::Iterator* Json::SnapshotView::Iterator::operator++()
+{
+	index++;
+	return this;
+}
+
+bool Json::SnapshotView::Iterator::operator!=(const Iterator& other) const
+{
+	return index != other.index;
+}
+
+Json::SnapshotView::Iterator& Json::SnapshotView::Iterator::operator*()
+{
+	return *this;
+}
+
+std::string_view Json::SnapshotView::Iterator::Key() const
+{
+	return view->KeyAt(index);
+}
+
+Json::SnapshotView Json::SnapshotView::Iterator::Value() const
+{
+	return view->Child(view->MemberAt(index));
+}
+
+namespace
+{
+	int OpenFile(const std::string& path, const bool bAppend)
+	{
+#ifdef _WIN32
+		if (bAppend)
+			return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+		return _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+		if (bAppend)
+			return open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+		return open(path.c_str(), O_RDONLY);
+#endif
+	}
+
+	void CloseFile(const int fd)
+	{
+#ifdef _WIN32
+		_close(fd);
+#else
+		close(fd);
+#endif
+	}
+
+	//Count read, zero at the end of the file and negative on failure
+	ptrdiff_t ReadFile(const int fd, char* data, const size_t size)
+	{
+#ifdef _WIN32
+		return _read(fd, data, (unsigned)std::min(size, (size_t)INT_MAX));
+#else
+		return read(fd, data, size);
+#endif
+	}
+
+	void WriteFile(const int fd, const char* data, const size_t length)
+	{
+		size_t written{ 0 };
+		while (written < length)
+		{
+#ifdef _WIN32
+			const auto count = _write(fd, data + written, (unsigned)std::min(length - written, (size_t)INT_MAX));
+#else
+			const auto count = write(fd, data + written, length - written);
+#endif
+			assert(count > 0);
+			if (count <= 0)
+				break;
+			written += (size_t)count;
+		}
+	}
+}
+
+Json::Writer::Writer(std::string& out, const bool bPretty)
+	:text(out), bPretty(bPretty)
+{
+}
+
+Json::Writer::Writer(std::ostream& os, const bool bPretty)
+	:os(&os), text(buffer), bPretty(bPretty)
+{
+	buffer.reserve(ChunkSize + ChunkSize / 4);
+}
+
+Json::Writer::Writer(const int fd, const bool bPretty)
+	:fd(fd), text(buffer), bPretty(bPretty)
+{
+	buffer.reserve(ChunkSize + ChunkSize / 4);
+}
+
+Json::Writer::~Writer() noexcept
+{
+	Flush();
+}
+
+Json::Writer& Json::Writer::Write(const Json& json)
+{
+	switch (json.GetType())
+	{
+	case Type::Null:
+		Writer::Null();
+		break;
+	case Type::Bool:
+		Writer::Bool(json.var_.boolVal);
+		break;
+	case Type::Int:
+		Writer::Int(json.var_.intVal);
+		break;
+	case Type::Float:
+		Writer::Float(json.var_.floatVal);
+		break;
+	case Type::Int64:
+		Writer::Int64(json.var_.int64Val);
+		break;
+	case Type::Double:
+		Writer::Double(json.var_.doubleVal);
+		break;
+	case Type::String:
+		Writer::String(json.var_.Str());
+		break;
+	case Type::Array:
+		Writer::StartArray();
+		WriteElements(*json.var_.arrayVal, 0, json.Size());
+		Writer::EndArray();
+		break;
+	case Type::Object:
+		Writer::StartObject();
+		for (const auto& obj : *json.var_.objectVal)
+		{
+			Writer::Key(obj.first);
+			Write(obj.second);
+		}
+		Writer::EndObject();
+		break;
+	default:
+		break;
+	}
+	return *this;
+}
+
+void Json::Writer::WriteRange(const Json& container, const size_t begin, const size_t end)
+{
+	levels.push_back(begin);
+	if (container.GetType() == Type::Array)
+		WriteElements(*container.var_.arrayVal, begin, end);
+	else
+	{
+		auto entry = static_cast<const ObjectStorage*>(container.var_.objectVal)->begin();
+		for (size_t i = 0; i < begin; i++)
+			++entry;
+		for (size_t i = begin; i < end; i++, ++entry)
+		{
+			Key(entry->first);
+			Write(entry->second);
+		}
+	}
+	levels.pop_back();
+}
+
+//The numbers of a packed array go out straight from where they are packed
+void Json::Writer::WriteElements(const ArrayStorage& array, const size_t begin, const size_t end)
+{
+	if (const auto* ints = array.Numbers<int>())
+		for (auto i = begin; i < end; i++)
+			Writer::Int(ints[i]);
+	else if (const auto* floats = array.Numbers<float>())
+		for (auto i = begin; i < end; i++)
+			Writer::Float(floats[i]);
+	else if (const auto* int64s = array.Numbers<int64_t>())
+		for (auto i = begin; i < end; i++)
+			Writer::Int64(int64s[i]);
+	else if (const auto* doubles = array.Numbers<double>())
+		for (auto i = begin; i < end; i++)
+			Writer::Double(doubles[i]);
+	else if (array.GetPacking() != Type::Null)
+		for (auto i = begin; i < end; i++)
+			Write(array.Get(i));
+	else
+		for (auto i = begin; i < end; i++)
+			Write(array[i]);
+}
+
+void Json::Writer::Flush()
+{
+	if (text.empty() || (!os && fd < 0))
+		return;
+	if (os)
+		os->write(text.data(), (std::streamsize)text.length());
+	else
+		WriteFile(fd, text.data(), text.length());
+	text.clear();
+}
+
+bool Json::Writer::Null()
+{
+	BeforeValue();
+	text.append("null", 4);
+	return AfterValue();
+}
+
+bool Json::Writer::Bool(const bool bval)
+{
+	BeforeValue();
+	if (bval)
+		text.append("true", 4);
+	else
+		text.append("false", 5);
+	return AfterValue();
+}
+
+bool Json::Writer::Int(const int val)
+{
+	BeforeValue();
+	char digits[16];
+	const auto result = std::to_chars(digits, digits + sizeof(digits), val);
+	text.append(digits, result.ptr);
+	return AfterValue();
+}
+
+bool Json::Writer::Float(const float val)
+{
+	BeforeValue();
+	PutReal(val);
+	return AfterValue();
+}
+
+bool Json::Writer::Int64(const int64_t val)
+{
+	BeforeValue();
+	char digits[24];
+	const auto result = std::to_chars(digits, digits + sizeof(digits), val);
+	text.append(digits, result.ptr);
+	return AfterValue();
+}
+
+bool Json::Writer::Double(const double val)
+{
+	BeforeValue();
+	PutReal(val);
+	return AfterValue();
+}
+
+template<typename Real>
+void Json::Writer::PutReal(const Real val)
+{
+	//JSON has no infinities or NaN
+	if (!std::isfinite(val))
+	{
+		text.append("null", 4);
+		return;
+	}
+	//Shortest digits that read back as the same value, with a fraction kept on whole numbers so they load back as reals
+	char digits[32];
+	const auto result = std::to_chars(digits, digits + sizeof(digits), val);
+	text.append(digits, result.ptr);
+	if (std::find_if(digits, result.ptr, [](const char ch) { return ch == '.' || ch == 'e'; }) == result.ptr)
+		text.append(".0", 2);
+}
+
+bool Json::Writer::String(std::string_view str)
+{
+	BeforeValue();
+	PutString(str);
+	return AfterValue();
+}
+
+bool Json::Writer::StartObject()
+{
+	BeforeValue();
+	text.push_back('{');
+	levels.push_back(0);
+	return true;
+}
+
+bool Json::Writer::Key(std::string_view key)
+{
+	BeforeValue();
+	PutString(key);
+	text.push_back(':');
+	if (bPretty)
+		text.push_back(' ');
+	bAfterKey = true;
+	return true;
+}
+
+bool Json::Writer::EndObject()
+{
+	EndContainer('}');
+	return AfterValue();
+}
+
+bool Json::Writer::StartArray()
+{
+	BeforeValue();
+	text.push_back('[');
+	levels.push_back(0);
+	return true;
+}
+
+bool Json::Writer::EndArray()
+{
+	EndContainer(']');
+	return AfterValue();
+}
+
+void Json::Writer::BeforeValue()
+{
+	if (bAfterKey)
+	{
+		bAfterKey = false;
+		return;
+	}
+	if (levels.empty())
+		return;
+	if (levels.back()++ > 0)
+		text.push_back(',');
+	if (bPretty)
+		NewLine();
+}
+
+bool Json::Writer::AfterValue()
+{
+	if (text.length() >= ChunkSize)
+		Flush();
+	return true;
+}
+
+void Json::Writer::EndContainer(const char close)
+{
+	assert(!levels.empty());
+	const auto count = levels.back();
+	levels.pop_back();
+	if (bPretty && count > 0)
+		NewLine();
+	text.push_back(close);
+}
+
+void Json::Writer::NewLine()
+{
+	text.push_back('\n');
+	text.append(levels.size() * 2, ' ');
+}
+
+void Json::Writer::PutString(std::string_view str)
+{
+	static const char HEX_DIGITS[] = "0123456789abcdef";
+	text.push_back('\"');
+	const char* run = str.data();
+	const char* end = str.data() + str.length();
+	for (const char* cur = run; cur != end; cur++)
+	{
+		const auto ch = (unsigned char)*cur;
+		if (ch >= 0x20 && ch != '\"' && ch != '\\')
+			continue;
+		text.append(run, cur);
+		run = cur + 1;
+		text.push_back('\\');
+		switch (ch)
+		{
+		case '\"':	text.push_back('\"'); break;
+		case '\\':	text.push_back('\\'); break;
+		case '\b':	text.push_back('b'); break;
+		case '\f':	text.push_back('f'); break;
+		case '\n':	text.push_back('n'); break;
+		case '\r':	text.push_back('r'); break;
+		case '\t':	text.push_back('t'); break;
+		default:
+			text.append("u00", 3);
+			text.push_back(HEX_DIGITS[ch >> 4]);
+			text.push_back(HEX_DIGITS[ch & 0xF]);
+			break;
+		}
+	}
+	text.append(run, end);
+	text.push_back('\"');
+}
+
+Json::LineReader::LineReader(const std::string& path, const ObjectOrder order)
+	:LineReader(OpenFile(path, false), order)
+{
+	assert(fd >= 0);
+	bOwned = fd >= 0;
+}
+
+Json::LineReader::LineReader(const int fd, const ObjectOrder order)
+	:fd(fd), order(order), buffer(BlockSize)
+{
+}
+
+Json::LineReader::~LineReader() noexcept
+{
+	record = Json();
+	if (bOwned)
+		CloseFile(fd);
+}
+
+bool Json::LineReader::IsOpen() const
+{
+	return fd >= 0;
+}
+
+bool Json::LineReader::Next()
+{
+	bMalformed = false;
+	std::string_view text;
+	do
+	{
+		if (!ReadLine(text))
+			return false;
+		line++;
+	} while (text.find_first_not_of(" \t\r") == std::string_view::npos);
+
+	//Parsed nodes take a few times the room of their text. The arena, and the keys interned in it, carry on until the block
+	//is about used up, then it starts over in a block grown to fit the record if need be
+	record = Json();
+	const auto size = text.length() * 4;
+	if (!arena || used + size > block.size() * sizeof(std::max_align_t))
+	{
+		arena.reset();
+		if (block.size() * sizeof(std::max_align_t) < std::max(BlockSize, size))
+			block.resize(std::max(BlockSize, size) / sizeof(std::max_align_t) + 1);
+		arena.emplace(block.data(), block.size() * sizeof(std::max_align_t));
+		used = 0;
+	}
+	used += size;
+	bMalformed = !TryParseInto(record, text.data(), text.length(), &*arena, order);
+	return !bMalformed;
+}
+
+const Json& Json::LineReader::Record() const
+{
+	return record;
+}
+
+size_t Json::LineReader::Line() const
+{
+	return line;
+}
+
+bool Json::LineReader::IsMalformed() const
+{
+	return bMalformed;
+}
+
+//Lines are copied into batches as they are found, workers parse theirs into an arena each of them keeps starting over in
+bool Json::LineReader::ForEachBatch(const size_t batchSize, const unsigned threads, const std::function<void(const std::vector<Json>& records, const size_t first)>& process)
+{
+	struct Batch
+	{
+		std::string text;
+		std::vector<size_t> ends;
+		size_t first{ 0 };
+	};
+	std::atomic<bool> bFailed{ false };
+	const auto order = this->order;
+	const auto parse = [&bFailed, &process, order](const Batch& batch, std::vector<std::max_align_t>& memory, std::vector<Json>& records)
+	{
+		const auto size = std::max(BlockSize, batch.text.length() * 4);
+		if (memory.size() * sizeof(std::max_align_t) < size)
+			memory.resize(size / sizeof(std::max_align_t) + 1);
+		Arena batchArena(memory.data(), memory.size() * sizeof(std::max_align_t));
+		records.resize(batch.ends.size());
+		size_t start{ 0 };
+		for (size_t i = 0; i < batch.ends.size(); i++)
+		{
+			if (!TryParseInto(records[i], batch.text.data() + start, batch.ends[i] - start, &batchArena, order))
+			{
+				bFailed = true;
+				break;
+			}
+			start = batch.ends[i];
+		}
+		if (!bFailed)
+			process(records, batch.first);
+		records.clear();
+	};
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<Batch> queue;
+	bool bDone = false;
+	const auto workerCount = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::thread> workers;
+	if (workerCount > 1)
+		for (unsigned i = 0; i < workerCount; i++)
+			workers.emplace_back([&]
+			{
+				std::vector<std::max_align_t> memory;
+				std::vector<Json> records;
+				std::unique_lock<std::mutex> lock(mutex);
+				while (true)
+				{
+					changed.wait(lock, [&] { return !queue.empty() || bDone; });
+					if (queue.empty())
+						return;
+					const auto batch = std::move(queue.front());
+					queue.pop_front();
+					changed.notify_all();
+					lock.unlock();
+					parse(batch, memory, records);
+					lock.lock();
+				}
+			});
+
+	std::vector<std::max_align_t> memory;
+	std::vector<Json> records;
+	Batch batch;
+	std::string_view text;
+	while (!bFailed)
+	{
+		const bool bLine = ReadLine(text);
+		if (bLine)
+		{
+			line++;
+			if (text.find_first_not_of(" \t\r") == std::string_view::npos)
+				continue;
+			batch.text.append(text);
+			batch.ends.push_back(batch.text.length());
+			if (batch.ends.size() < batchSize)
+				continue;
+		}
+		if (!batch.ends.empty())
+		{
+			const auto first = batch.first + batch.ends.size();
+			if (workers.empty())
+				parse(batch, memory, records);
+			else
+			{
+				//A few batches waiting per worker keep them busy without reading far ahead of them
+				std::unique_lock<std::mutex> lock(mutex);
+				changed.wait(lock, [&] { return queue.size() < 2 * workers.size(); });
+				queue.push_back(std::move(batch));
+				changed.notify_all();
+			}
+			batch = Batch();
+			batch.first = first;
+		}
+		if (!bLine)
+			break;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		bDone = true;
+	}
+	changed.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+	return !bFailed;
+}
+
+bool Json::LineReader::ReadLine(std::string_view& text)
+{
+	while (true)
+	{
+		const auto newline = static_cast<const char*>(memchr(buffer.data() + begin, '\n', end - begin));
+		if (newline)
+		{
+			text = std::string_view(buffer.data() + begin, newline - buffer.data() - begin);
+			begin = newline - buffer.data() + 1;
+			return true;
+		}
+		if (bEnd)
+		{
+			if (begin == end)
+				return false;
+			//The last line needs no newline
+			text = std::string_view(buffer.data() + begin, end - begin);
+			begin = end;
+			return true;
+		}
+		//Moves the partial line to the front and reads more after it, growing the buffer for a line longer than it
+		if (begin > 0)
+		{
+			memmove(buffer.data(), buffer.data() + begin, end - begin);
+			end -= begin;
+			begin = 0;
+		}
+		if (end == buffer.size())
+			buffer.resize(buffer.size() * 2);
+		const auto count = fd >= 0 ? ReadFile(fd, buffer.data() + end, buffer.size() - end) : 0;
+		assert(count >= 0);
+		if (count <= 0)
+			bEnd = true;
+		else
+			end += (size_t)count;
+	}
+}
+
+Json::LineWriter::LineWriter(const std::string& path)
+	:LineWriter(OpenFile(path, true))
+{
+	assert(fd >= 0);
+	bOwned = fd >= 0;
+}
+
+Json::LineWriter::LineWriter(const int fd)
+	:fd(fd), writer(buffer)
+{
+	buffer.reserve(ChunkSize + ChunkSize / 4);
+}
+
+Json::LineWriter::~LineWriter() noexcept
+{
+	Flush();
+	if (bOwned)
+		CloseFile(fd);
+}
+
+bool Json::LineWriter::IsOpen() const
+{
+	return fd >= 0;
+}
+
+Json::LineWriter& Json::LineWriter::Write(const Json& record)
+{
+	writer.Write(record);
+	buffer.push_back('\n');
+	if (buffer.length() >= ChunkSize)
+		Flush();
+	return *this;
+}
+
+void Json::LineWriter::Flush()
+{
+	if (fd >= 0 && !buffer.empty())
+		WriteFile(fd, buffer.data(), buffer.length());
+	buffer.clear();
+}
+
+Json::PushParser::PushParser(const ObjectOrder order)
+	:order(order)
+{
+	Reset();
+}
+
+Json::PushParser::~PushParser() = default;
+
+bool Json::PushParser::Feed(std::string_view data)
+{
+	return Feed(data.data(), data.length());
+}
+
+//Follows the nesting byte by byte and hands every key and scalar to the regular parser once all of it is there
+bool Json::PushParser::Feed(const char* data, const size_t length)
+{
+	const char* cur = data;
+	const char* end = data + length;
+	//Start of a token that began in this piece, one from an earlier piece is in pending
+	const char* start = nullptr;
+	while (cur != end && !bFailed)
+	{
+		if (token != Token::None)
+		{
+			bool bDone;
+			const char* stop = ScanToken(cur, end, bDone);
+			if (!bDone)
+			{
+				pending.append(start ? start : cur, end);
+				return true;
+			}
+			if (start)
+				bFailed = !Emit(std::string_view(start, stop - start));
+			else
+			{
+				pending.append(cur, stop);
+				bFailed = !Emit(pending);
+				pending.clear();
+			}
+			start = nullptr;
+			cur = stop;
+			continue;
+		}
+
+		const char ch = *cur;
+		if (ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t')
+		{
+			cur++;
+			continue;
+		}
+		switch (expect)
+		{
+		case Expect::Value:
+		case Expect::ValueOrClose:
+			if (ch == '{')
+			{
+				containers.push_back('{');
+				expect = Expect::KeyOrClose;
+				bFailed = !builder->StartObject();
+			}
+			else if (ch == '[')
+			{
+				containers.push_back('[');
+				expect = Expect::ValueOrClose;
+				bFailed = !builder->StartArray();
+			}
+			else if (ch == ']' && expect == Expect::ValueOrClose)
+				bFailed = !Close(ch);
+			else if (ch == ',' || ch == ':' || ch == ']' || ch == '}')
+				bFailed = true;
+			else
+			{
+				//The opening quote is not scanned for the closing one
+				token = ch == '"' ? Token::String : Token::Scalar;
+				start = cur;
+				bEscape = false;
+				if (token == Token::Scalar)
+					continue;
+			}
+			break;
+		case Expect::Key:
+		case Expect::KeyOrClose:
+			if (ch == '}' && expect == Expect::KeyOrClose)
+				bFailed = !Close(ch);
+			else if (ch == '"')
+			{
+				token = Token::Key;
+				start = cur;
+				bEscape = false;
+			}
+			else
+				bFailed = true;
+			break;
+		case Expect::Colon:
+			bFailed = ch != ':';
+			expect = Expect::Value;
+			break;
+		case Expect::CommaOrClose:
+			if (ch == ',')
+				expect = containers.back() == '{' ? Expect::Key : Expect::Value;
+			else
+				bFailed = !Close(ch);
+			break;
+		default:
+			bFailed = true;
+			break;
+		}
+		cur++;
+	}
+	//The piece ended right after an opening quote
+	if (token != Token::None && start)
+		pending.append(start, end);
+	return !bFailed;
+}
+
+Json Json::PushParser::Finish()
+{
+	//Nothing follows a number or literal at the very end to show where it stops
+	if (token == Token::Scalar && !bFailed)
+	{
+		bFailed = !Emit(pending);
+		pending.clear();
+	}
+	//Input comes from outside, so bad or cut off text is an answer rather than a bug
+	const bool bValid = !bFailed && token == Token::None && expect == Expect::End;
+	builder.reset();
+	Json result = bValid ? std::move(root) : Json();
+	Reset();
+	return result;
+}
+
+//Past the closing quote of a string, scanning from after the opening one, or up to whatever ends a number or literal.
+//bDone unless the piece ends first
+const char* Json::PushParser::ScanToken(const char* cur, const char* end, bool& bDone)
+{
+	bDone = true;
+	if (token == Token::Scalar)
+	{
+		for (; cur != end; cur++)
+			if (*cur == ' ' || *cur == '\n' || *cur == '\r' || *cur == '\t' || *cur == ',' || *cur == ']' || *cur == '}' || *cur == ':')
+				return cur;
+		bDone = false;
+		return end;
+	}
+	for (; cur != end; cur++)
+	{
+		if (bEscape)
+			bEscape = false;
+		else if (*cur == '\\')
+			bEscape = true;
+		else if (*cur == '"')
+			return cur + 1;
+	}
+	bDone = false;
+	return end;
+}
+
+bool Json::PushParser::Emit(std::string_view text)
+{
+	const bool bKey = token == Token::Key;
+	token = Token::None;
+	Parser<DomBuilder> parser(text.data(), text.data() + text.length(), *builder);
+	if (!parser.ParseToken(bKey))
+		return false;
+	expect = bKey ? Expect::Colon : containers.empty() ? Expect::End : Expect::CommaOrClose;
+	return true;
+}
+
+bool Json::PushParser::Close(const char close)
+{
+	if (containers.empty() || containers.back() != (close == '}' ? '{' : '['))
+		return false;
+	containers.pop_back();
+	expect = containers.empty() ? Expect::End : Expect::CommaOrClose;
+	return close == '}' ? builder->EndObject() : builder->EndArray();
+}
+
+void Json::PushParser::Reset()
+{
+	root = Json();
+	builder = std::make_unique<DomBuilder>(root, HeapResource(), order);
+	containers.clear();
+	pending.clear();
+	expect = Expect::Value;
+	token = Token::None;
+	bEscape = false;
+	bFailed = false;
+}
+
+//Keeps the scalar the parser hands over last for Reader to convert, containers are taken apart by Reader itself
+struct Json::Reader::Source final : Handler
+{
+	Source(std::string_view js)
+		:parser(js.data(), js.data() + js.length(), *this)
+	{
+	}
+
+	bool Null() override { type = Type::Null; return true; }
+	bool Bool(const bool val) override { type = Type::Bool; bval = val; return true; }
+	bool Int(const int val) override { type = Type::Int; int64Val = val; return true; }
+	bool Int64(const int64_t val) override { type = Type::Int64; int64Val = val; return true; }
+	bool Double(const double val) override { type = Type::Double; doubleVal = val; return true; }
+	bool String(std::string_view val) override { type = Type::String; str = val; return true; }
+	bool StartObject() override { return false; }
+	bool StartArray() override { return false; }
+
+	//Pulls the next value, true if it is a number
+	bool PullNumber()
+	{
+		return parser.PullValue() && (type == Type::Int || type == Type::Int64 || type == Type::Double);
+	}
+
+	Parser<Source> parser;
+	Type type = Type::Null;
+	bool bval = false;
+	int64_t int64Val = 0;
+	double doubleVal = 0;
+	std::string_view str;
+};
+
+Json::Reader::Reader(std::string_view js)
+	:source(std::make_unique<Source>(js))
+{
+}
+
+Json::Reader::~Reader() = default;
+
+bool Json::Reader::Read(bool& val)
+{
+	if (!source->parser.PullValue() || source->type != Type::Bool)
+		return false;
+	val = source->bval;
+	return true;
+}
+
+bool Json::Reader::Read(int& val)
+{
+	if (!source->parser.PullValue() || source->type != Type::Int)
+		return false;
+	val = (int)source->int64Val;
+	return true;
+}
+
+bool Json::Reader::Read(int64_t& val)
+{
+	if (!source->parser.PullValue() || (source->type != Type::Int && source->type != Type::Int64))
+		return false;
+	val = source->int64Val;
+	return true;
+}
+
+bool Json::Reader::Read(float& val)
+{
+	double real{ 0 };
+	if (!Read(real))
+		return false;
+	val = (float)real;
+	return true;
+}
+
+bool Json::Reader::Read(double& val)
+{
+	if (!source->PullNumber())
+		return false;
+	val = source->type == Type::Double ? source->doubleVal : (double)source->int64Val;
+	return true;
+}
+
+bool Json::Reader::Read(std::string& val)
+{
+	if (!source->parser.PullValue() || source->type != Type::String)
+		return false;
+	val.assign(source->str.data(), source->str.length());
+	return true;
+}
+
+bool Json::Reader::StartObject()
+{
+	bFirst = true;
+	return source->parser.PullChar('{');
+}
+
+bool Json::Reader::NextKey(std::string_view& key, bool& bMore)
+{
+	return Next('}', bMore) && (!bMore || source->parser.PullKey(key));
+}
+
+bool Json::Reader::StartArray()
+{
+	bFirst = true;
+	return source->parser.PullChar('[');
+}
+
+bool Json::Reader::NextElement(bool& bMore)
+{
+	return Next(']', bMore);
+}
+
+//Only the innermost open container is ever being stepped through, so one flag for whether it is past its first member does
+//for all of them: it is cleared by the first step into a container, which comes before anything nested in that member opens
+bool Json::Reader::Next(const char close, bool& bMore)
+{
+	bMore = !source->parser.PullChar(close);
+	if (!bMore || bFirst)
+	{
+		bFirst = false;
+		return true;
+	}
+	return source->parser.PullChar(',');
+}
+
+bool Json::Reader::Skip()
+{
+	return source->parser.PullSkip();
+}
+
+bool Json::Reader::Finish()
+{
+	return source->parser.PullEnd();
+}
+
+namespace
+{
+	//Counts arenas released, so that a slot handed out before one was is not taken to still be in it
+	std::atomic<uint64_t> arenasReleased{ 0 };
+
+	//The slot a non-const accessor last handed out on this thread, with the resource of the container it is in
+	struct HandedSlot
+	{
+		const Json* slot = nullptr;
+		std::pmr::memory_resource* resource = nullptr;
+		uint64_t released = 0;
+	};
+	thread_local HandedSlot handed;
+}
+
+//A scalar slot has no resource of its own, so the container or document handing it out passes its resource down to the next
+//copy into the slot on the same thread
+Json& Json::HandOut(Json& slot, std::pmr::memory_resource* resource)
+{
+	handed = HandedSlot{ &slot, resource, arenasReleased.load(std::memory_order_acquire) };
+	return slot;
+}
+
+//A container or heap string copies into its own resource, a scalar slot into the one its container passed down, or the heap
+//once another slot has been handed out since
+std::pmr::memory_resource* Json::SlotResource(const Json& value) const
+{
+	const auto owns = [](const Var& var)
+	{
+		return var.type == Type::Array || var.type == Type::Object || (var.type == Type::String && (var.shortLength == Var::HeapString || var.shortLength == Var::Shared));
+	};
+	if (owns(var_) || !owns(value.var_))
+		return var_.Resource();
+	if (handed.slot == this && handed.released == arenasReleased.load(std::memory_order_acquire))
+		return handed.resource;
+	return var_.Resource();
+}
+
+Json& Json::operator=(const Json& other)
+{
+	//assert(GetType() == other.GetType());
+	if (this != &other)
+		*this = Clone(other, SlotResource(other));
+	return *this;
+}
+
+Json& Json::operator=(Json&& other) noexcept
+{
+	//assert(GetType() == other.GetType());
+	if (this != &other)
+	{
+		Var old = var_;
+		var_ = other.var_;
+		other.var_ = Var();
+		old.Release();
+	}
+	return *this;
+}
+
+Json& Json::operator[](const std::string& key)
+{
+	return Member(key);
+}
+
+const Json& Json::operator[](const std::string& key) const
+{
+	return Member(key);
+}
+
+Json& Json::operator[](const char* key)
+{
+	return Member(key);
+}
+
+const Json& Json::operator[](const char* key) const
+{
+	return Member(key);
+}
+
+Json& Json::Member(std::string_view key)
+{
+	assert(GetType() == Type::Object);
+	var_.Detach();
+	const auto value = var_.objectVal->Find(key);
+
+	assert(value);
+	return HandOut(*value, var_.Resource());
+}
+
+//A missing key reads as null
+const Json& Json::Member(std::string_view key) const
+{
+	static const Json null;
+	assert(GetType() == Type::Object);
+	const auto value = var_.objectVal->Find(key);
+	return value ? *value : null;
+}
+
+bool Json::operator==(const Json& other) const
+{
+	if (var_.IsNumber() && other.var_.IsNumber())
+		return var_.NumberEquals(other.var_);
+	if (GetType() != other.GetType())
+		return false;
+	switch (GetType())
+	{
+		case Type::Bool:	return var_.boolVal == other.var_.boolVal;
+		case Type::String:	return var_.Str() == other.var_.Str();
+		case Type::Array:	return !var_.HashDiffers(other.var_) && Compare(*var_.arrayVal, *other.var_.arrayVal);
+		case Type::Object:	return !var_.HashDiffers(other.var_) && Compare(*var_.objectVal, *other.var_.objectVal);
+		default:			return true;
+	}
+}
+
+bool Json::operator!=(const Json& other) const
+{
+	return !(*this==other);
+}
+
+const Json& Json::operator[](size_t i) const
+{
+	assert(GetType() == Type::Array);
+	return (*static_cast<const ArrayStorage*>(var_.arrayVal))[i];
+}
+
+const Json& Json::operator[](int i) const
+{
+	return (*this)[(size_t)i];
+}
+
+Json& Json::operator[](size_t i)
+{
+	assert(GetType() == Type::Array);
+	var_.Detach();
+	return HandOut((*var_.arrayVal)[i], var_.Resource());
+}
+
+Json& Json::operator[](int i)
+{
+	return (*this)[(size_t)i];
+}
+
+Json::operator bool() const
+{
+	if (GetType() != Type::Bool)
+		return false;
+	return var_.boolVal;
+}
+
+Json::operator int() const
+{
+	return var_.AsInt();
+}
+
+Json::operator float() const
+{
+	if (GetType() == Type::Float)
+		return var_.floatVal;
+	return (float)var_.AsDouble();
+}
+
+Json::operator int64_t() const
+{
+	return var_.AsInt64();
+}
+
+Json::operator double() const
+{
+	return var_.AsDouble();
+}
+
+Json::operator std::string() const
+{
+	if (GetType() != Type::String)
+		return std::string("");
+	return std::string(var_.Str());
+}
+
+std::string_view Json::GetString() const
+{
+	if (GetType() != Type::String)
+		return std::string_view();
+	return var_.Str();
+}
+
+
+bool Json::operator==(Json& other)
+{
+	return static_cast<const Json&>(*this) == other;
+}
+
+bool Json::operator!=(Json& other)
+{
+	return !(*this == other);
+}
+
+Json& Json::Insert(const Json& val, const size_t index)
+{
+	return Insert(Clone(val, var_.Resource()), index);
+}
+
+Json& Json::Insert(Json&& val, const size_t index)
+{
+	assert(GetType() == Type::Array);
+	var_.Detach();
+	if (var_.IsShared())
+		val.Share();
+	return var_.arrayVal->Insert(index, std::move(val));
+}
+
+Json& Json::Add(const Json& val)
+{
+	assert(GetType() == Type::Array);
+	auto&	result = Insert(val, var_.arrayVal->size());
+	return	result;
+}
+
+Json& Json::Add(Json&& val)
+{
+	if (this == &val)
+		return Add(val);
+	assert(GetType() == Type::Array);
+	auto	&result = Insert(std::move(val), var_.arrayVal->size());
+	return	result;
+}
+
+std::vector<std::string> Json::GetKeys() const
+{
+	std::vector<std::string> keys;
+	if (GetType() == Type::Object)
+	{
+		for (const auto& key : *var_.objectVal)
+			keys.emplace_back(key.first.View());
+		return keys;
+	}
+}
+
+void Json::Var::Emplace(const Type type, std::pmr::memory_resource* resource, const ObjectOrder order, const bool bShared)
+{
+	this->type = type;
+	switch (type)
+	{
+	case Type::String:
+		shortLength = 0;
+		break;
+	case Type::Array:
+		shortLength = bShared ? Shared : 0;
+		arrayVal = bShared ? CreateShared<ArrayStorage>(resource) : Create<ArrayStorage>(resource);
+		break;
+	case Type::Object:
+		shortLength = bShared ? Shared : 0;
+		objectVal = bShared ? CreateShared<ObjectStorage>(resource, order) : Create<ObjectStorage>(resource, order);
+		break;
+	default:
+		break;
+	}
+}
+
+void Json::Var::SetString(std::string_view str, std::pmr::memory_resource* resource)
+{
+	type = Type::String;
+	if (str.length() <= ShortCapacity)
+	{
+		shortLength = (uint8_t)str.length();
+		memcpy(ShortChars(), str.data(), str.length());
+		return;
+	}
+	shortLength = HeapString;
+	stringVal = Create<std::pmr::string>(resource);
+	stringVal->assign(str.data(), str.length());
+}
+
+void Json::Var::SetBorrowed(std::string_view str)
+{
+	assert(str.length() > ShortCapacity && str.length() <= UINT32_MAX);
+	type = Type::String;
+	shortLength = BorrowedString;
+	borrowedLength = (uint32_t)str.length();
+	borrowedChars = str.data();
+}
+
+void Json::Var::Copy(const Var& src, std::pmr::memory_resource* resource)
+{
+	//A shared node only stays shared within its resource, copies into another document or out of one are deep
+	if (src.IsShared() && src.Resource() == resource)
+	{
+		src.Count().refs.fetch_add(1, std::memory_order_relaxed);
+		*this = src;
+		return;
+	}
+	Duplicate(src, resource, false);
+}
+
+//Copies the node itself, its members go through Copy and so are shared if they already were
+void Json::Var::Duplicate(const Var& src, std::pmr::memory_resource* resource, const bool bShared)
+{
+	switch (src.type)
+	{
+	case Json::String:
+		assert(!bShared);
+		SetString(src.Str(), resource);
+		break;
+	case Json::Array:
+		Emplace(Type::Array, resource, DefaultObjectOrder, bShared);
+		if (arrayVal->CopyPacked(*src.arrayVal))
+			break;
+		arrayVal->reserve(src.arrayVal->size());
+		src.arrayVal->ForEach([this, resource](const Json& srcElement)
+		{
+			Json element;
+			element.var_.Copy(srcElement.var_, resource);
+			arrayVal->Push(std::move(element));
+		});
+		break;
+	case Json::Object:
+	{
+		const auto pool = PoolOf(resource);
+		Emplace(Type::Object, resource, src.objectVal->GetOrder(), bShared);
+		objectVal->reserve(src.objectVal->size());
+		for (const auto& srcElement : *src.objectVal)
+			objectVal->Append(ShareKey(srcElement.first, pool)).var_.Copy(srcElement.second.var_, resource);
+		objectVal->Finalize();
+		break;
+	}
+	default:
+		*this = src;
+		break;
+	}
+}
+
+//Nodes held by another value are left alone, so a tree that is already shared costs nothing to share again
+void Json::Var::Share()
+{
+	if (IsShared() && Count().refs.load(std::memory_order_acquire) > 1)
+		return;
+	switch (type)
+	{
+	case Json::String:
+		if (shortLength != HeapString)
+			return;
+		stringVal = MakeShared(stringVal);
 		break;
-	case Type::Int:
-		text += std::to_string(json.var_->intVal);
+	case Json::Array:
+		arrayVal->Settle();
+		if (arrayVal->GetPacking() == Type::Null)
+			for (auto& element : *arrayVal)
+				element.var_.Share();
+		if (shortLength != Shared)
+			arrayVal = MakeShared(arrayVal);
 		break;
-	case Type::Float:
-		text += std::to_string(json.var_->floatVal);
+	case Json::Object:
+		for (auto& entry : *objectVal)
+			entry.second.var_.Share();
+		if (shortLength != Shared)
+			objectVal = MakeShared(objectVal);
 		break;
-	case Type::Bool:
-		text += json.var_->boolVal ? "true" : "false";
+	default:
+		return;
+	}
+	shortLength = Shared;
+}
+
+//Gives a shared container storage of its own before it is changed, unless nothing else holds it
+void Json::Var::Detach()
+{
+	if (!IsShared())
+		return;
+	auto& count = Count();
+	if (count.refs.load(std::memory_order_acquire) == 1)
+	{
+		count.hash.store(0, std::memory_order_relaxed);
+		return;
+	}
+	Var copy;
+	copy.Duplicate(*this, Resource(), true);
+	Release();
+	*this = copy;
+}
+
+bool Json::Var::IsShared() const
+{
+	return (type == Type::String || type == Type::Array || type == Type::Object) && shortLength == Shared;
+}
+
+Json::SharedCount& Json::Var::Count() const
+{
+	const void* storage = type == Type::String ? (const void*)stringVal : type == Type::Array ? (const void*)arrayVal : (const void*)objectVal;
+	return *reinterpret_cast<SharedCount*>(const_cast<char*>(static_cast<const char*>(storage)) - sizeof(SharedCount));
+}
+
+//Hash of a shared container if it has been worked out already, zero otherwise
+uint64_t Json::Var::CachedHash() const
+{
+	if ((type != Type::Array && type != Type::Object) || shortLength != Shared)
+		return 0;
+	return Count().hash.load(std::memory_order_relaxed);
+}
+
+//Whether two containers of the same type are known to differ without comparing their members
+bool Json::Var::HashDiffers(const Var& other) const
+{
+	if (shortLength != Shared || other.shortLength != Shared)
+		return false;
+	const auto hash = CachedHash();
+	const auto otherHash = other.CachedHash();
+	return hash && otherHash && hash != otherHash;
+}
+
+void Json::Var::Release() noexcept
+{
+	switch (type)
+	{
+	case Json::String:
+		if (shortLength == HeapString)
+			Destroy(stringVal);
+		else if (shortLength == Shared)
+			ReleaseShared(stringVal);
 		break;
-	case Type::String:
-		text += '\"' + *json.var_->stringVal + '\"';
+	case Json::Array:
+		if (shortLength == Shared)
+			ReleaseShared(arrayVal);
+		else
+			Destroy(arrayVal);
 		break;
-	case Type::Array:
-		text += '[';
-		for (const auto& val : json)
-		{		
-			text += '\n';
-			for (size_t i = 0; i < off + 2; i++) text.push_back(' ');
-			PrintS(text, nextOffset, val.Value()); text += ",";
-		}
-		text += '\n'; for (size_t i = 0; i < off; i++) text.push_back(' '); text += "]";	
+	case Json::Object:
+		if (shortLength == Shared)
+			ReleaseShared(objectVal);
+		else
+			Destroy(objectVal);
 		break;
-	case Type::Object:
-		text += '{';
-		for (auto& val : json)
-		{
-			text += '\n';
-			for (size_t i = 0; i < off+2; i++) text.push_back(' ');
-			text += '\"' + val.Key() + '\"' + ": ";
-			PrintS(text, nextOffset, val.Value()); text += ',';
-		}
-		if (text[text.length() - 1] == ',')
-			text.pop_back();
-		text += '\n'; for (size_t i = 0; i < off; i++) text.push_back(' ');	text += '}';
+	default:
+		break;
+	}
+	type = Type::Null;
+}
+
+std::string_view Json::Var::Str() const
+{
+	if (shortLength == HeapString || shortLength == Shared)
+		return *stringVal;
+	if (shortLength == BorrowedString)
+		return std::string_view(borrowedChars, borrowedLength);
+	return std::string_view(ShortChars(), shortLength);
+}
+
+std::pmr::memory_resource* Json::Var::Resource() const
+{
+	switch (type)
+	{
+	case Json::String:
+		if (shortLength == HeapString || shortLength == Shared)
+			return stringVal->get_allocator().resource();
 		break;
+	case Json::Array:
+		return arrayVal->get_allocator().resource();
+	case Json::Object:
+		return objectVal->get_allocator().resource();
 	default:
 		break;
-	}	
+	}
+	return HeapResource();
+}
+
+bool Json::Var::IsNumber() const
+{
+	return type == Type::Int || type == Type::Float || type == Type::Int64 || type == Type::Double;
+}
+
+//Reals are truncated, saturating past int64_t's range, and NaN reads as 0
+int64_t Json::Var::AsInt64() const
+{
+	switch (type)
+	{
+	case Json::Int:		return intVal;
+	case Json::Int64:	return int64Val;
+	case Json::Float:
+	case Json::Double:
+	{
+		const double val = AsDouble();
+		if (val != val)
+			return 0;
+		if (val >= 9223372036854775808.0)
+			return INT64_MAX;
+		if (val < -9223372036854775808.0)
+			return INT64_MIN;
+		return (int64_t)val;
+	}
+	default:			return 0;
+	}
+}
+
+int Json::Var::AsInt() const
+{
+	if (type == Type::Int)
+		return intVal;
+	return (int)std::clamp<int64_t>(AsInt64(), INT_MIN, INT_MAX);
+}
+
+double Json::Var::AsDouble() const
+{
+	switch (type)
+	{
+	case Json::Int:		return intVal;
+	case Json::Float:	return floatVal;
+	case Json::Int64:	return (double)int64Val;
+	case Json::Double:	return doubleVal;
+	default:			return 0.0;
+	}
+}
+
+//Numbers are equal when they hold exactly the same value, whichever type holds them, so that equality stays transitive.
+//Floats widen to doubles exactly, and a real only equals an integer if it is that whole number
+bool Json::Var::NumberEquals(const Var& other) const
+{
+	const bool bReal = type == Type::Float || type == Type::Double;
+	const bool bOtherReal = other.type == Type::Float || other.type == Type::Double;
+	if (bReal && bOtherReal)
+		return AsDouble() == other.AsDouble();
+	if (!bReal && !bOtherReal)
+		return AsInt64() == other.AsInt64();
+	int64_t whole;
+	return IsWhole(bReal ? AsDouble() : other.AsDouble(), whole) && whole == (bReal ? other.AsInt64() : AsInt64());
+}
+
+Json::ObjectStorage::ObjectStorage(const allocator_type& allocator)
+	:ObjectStorage(DefaultObjectOrder, allocator)
+{
+}
+
+Json::ObjectStorage::ObjectStorage(const ObjectOrder order, const allocator_type& allocator)
+	:entries(allocator), slots(allocator), sorted(allocator), order(order)
+{
+}
+
+Json::ObjectStorage::ObjectStorage(ObjectStorage&& other, const allocator_type& allocator)
+	:entries(std::move(other.entries), allocator), slots(std::move(other.slots), allocator), sorted(std::move(other.sorted), allocator), order(other.order)
+{
+	//The keys now belong to this object whether the entries were taken over or moved one by one
+	other.entries.clear();
+}
+
+Json::ObjectStorage::~ObjectStorage()
+{
+	for (const auto& entry : entries)
+		entry.first.Release();
+}
+
+auto Json::ObjectStorage::begin() -> iterator
+{
+	return iterator(entries.data(), sorted.empty() ? nullptr : sorted.data(), 0);
+}
+
+auto Json::ObjectStorage::end() -> iterator
+{
+	return iterator(entries.data(), nullptr, entries.size());
+}
+
+auto Json::ObjectStorage::begin() const -> const_iterator
+{
+	return const_iterator(entries.data(), sorted.empty() ? nullptr : sorted.data(), 0);
+}
+
+auto Json::ObjectStorage::end() const -> const_iterator
+{
+	return const_iterator(entries.data(), nullptr, entries.size());
+}
+
+size_t Json::ObjectStorage::size() const
+{
+	return entries.size();
+}
+
+bool Json::ObjectStorage::empty() const
+{
+	return entries.empty();
+}
+
+void Json::ObjectStorage::reserve(const size_t count)
+{
+	entries.reserve(count);
+}
+
+auto Json::ObjectStorage::get_allocator() const -> allocator_type
+{
+	return entries.get_allocator();
+}
+
+Json::ObjectOrder Json::ObjectStorage::GetOrder() const
+{
+	return order;
+}
+
+Json* Json::ObjectStorage::Find(std::string_view key)
+{
+	const auto index = FindIndex(key);
+	return index != entries.size() ? &entries[index].second : nullptr;
+}
+
+const Json* Json::ObjectStorage::Find(std::string_view key) const
+{
+	const auto index = FindIndex(key);
+	return index != entries.size() ? &entries[index].second : nullptr;
+}
+
+const Json* Json::ObjectStorage::Find(const Key& key) const
+{
+	return Find(key.View(), key.Hash());
+}
+
+const Json* Json::ObjectStorage::Find(std::string_view key, const uint32_t hash) const
+{
+	const auto index = FindIndex(key, hash, entries.size());
+	return index != entries.size() ? &entries[index].second : nullptr;
+}
+
+Json& Json::ObjectStorage::InsertOrAssign(std::string_view key, Json&& value)
+{
+	const auto hash = Key::HashOf(key);
+	auto index = FindIndex(key, hash, entries.size());
+	if (index != entries.size())
+		return entries[index].second = std::move(value);
+
+	const auto pool = PoolOf(get_allocator().resource());
+	const auto interned = pool ? pool->Intern(key, hash) : Key::Create(key, hash, HeapResource(), 1);
+	if (entries.size() < HashThreshold)
+	{
+		index = order == ObjectOrder::Sorted ? LowerBound(key) : entries.size();
+		return entries.emplace(entries.begin() + index, interned, std::move(value))->second;
+	}
+	if (slots.empty())
+		BuildIndex();
+
+	if (order == ObjectOrder::Sorted)
+		sorted.insert(sorted.begin() + SortedBound(key), (uint32_t)entries.size());
+	auto& entry = entries.emplace_back(interned, std::move(value));
+	if (entries.size() * 2 > slots.size())
+		Rehash();
+	else
+		InsertSlot((uint32_t)entries.size() - 1, hash);
+	return entry.second;
+}
+
+bool Json::ObjectStorage::Erase(std::string_view key)
+{
+	const auto index = FindIndex(key);
+	if (index == entries.size())
+		return false;
+
+	if (!sorted.empty())
+	{
+		sorted.erase(sorted.begin() + SortedBound(key));
+		for (auto& position : sorted)
+			if (position > index)
+				position--;
+	}
+	entries[index].first.Release();
+	entries.erase(entries.begin() + index);
+	if (slots.empty())
+		return true;
+
+	if (entries.size() <= HashThreshold)
+		Flatten();
+	else
+		Rehash();
+	return true;
+}
+
+Json& Json::ObjectStorage::Append(const Key& key)
+{
+	return entries.emplace_back(key, Json()).second;
+}
+
+void Json::ObjectStorage::Finalize()
+{
+	Flatten();
+	size_t unique{ 0 };
+	if (order == ObjectOrder::Sorted)
+	{
+		const auto byKey = [](const value_type& a, const value_type& b) { return a.first.View() < b.first.View(); };
+		if (!std::is_sorted(entries.begin(), entries.end(), byKey))
+			std::stable_sort(entries.begin(), entries.end(), byKey);
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			if (unique > 0 && entries[unique - 1].first == entries[i].first)
+			{
+				entries[unique - 1].second = std::move(entries[i].second);
+				entries[i].first.Release();
+			}
+			else if (unique++ != i)
+				entries[unique - 1] = std::move(entries[i]);
+		}
+		entries.erase(entries.begin() + unique, entries.end());
+		if (entries.size() > HashThreshold)
+			BuildIndex();
+		return;
+	}
+
+	if (entries.size() > HashThreshold)
+		slots.assign(SlotCount(entries.size()), { EmptySlot, 0 });
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		const auto& key = entries[i].first;
+		const auto index = FindIndex(key.View(), key.Hash(), unique);
+		if (index != unique)
+		{
+			entries[index].second = std::move(entries[i].second);
+			key.Release();
+			continue;
+		}
+		if (unique != i)
+			entries[unique] = std::move(entries[i]);
+		if (!slots.empty())
+			InsertSlot((uint32_t)unique, entries[unique].first.Hash());
+		unique++;
+	}
+	entries.erase(entries.begin() + unique, entries.end());
+}
+
+size_t Json::ObjectStorage::FindIndex(std::string_view key) const
+{
+	return FindIndex(key, slots.empty() ? 0 : Key::HashOf(key), entries.size());
+}
+
+size_t Json::ObjectStorage::FindIndex(std::string_view key, const uint32_t hash, const size_t count) const
+{
+	if (!slots.empty())
+	{
+		const auto mask = slots.size() - 1;
+		for (auto i = hash & mask; slots[i].index != EmptySlot; i = (i + 1) & mask)
+		{
+			const auto& slot = slots[i];
+			if (slot.hash == hash && entries[slot.index].first.View() == key)
+				return slot.index;
+		}
+		return count;
+	}
+	if (order == ObjectOrder::Sorted)
+	{
+		const auto index = LowerBound(key);
+		if (index != count && entries[index].first == key)
+			return index;
+		return count;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		if (entries[i].first.View() == key)
+			return i;
+	}
+	return count;
+}
+
+size_t Json::ObjectStorage::LowerBound(std::string_view key) const
+{
+	const auto it = std::lower_bound(entries.begin(), entries.end(), key,
+		[](const value_type& entry, std::string_view key) { return entry.first.View() < key; });
+	return it - entries.begin();
+}
+
+size_t Json::ObjectStorage::SortedBound(std::string_view key) const
+{
+	const auto it = std::lower_bound(sorted.begin(), sorted.end(), key,
+		[this](const uint32_t index, std::string_view key) { return entries[index].first.View() < key; });
+	return it - sorted.begin();
+}
+
+size_t Json::ObjectStorage::SlotCount(const size_t count)
+{
+	size_t capacity = 2 * HashThreshold;
+	while (capacity < count * 2)
+		capacity *= 2;
+	return capacity;
+}
+
+void Json::ObjectStorage::InsertSlot(const uint32_t index, const uint32_t hash)
+{
+	const auto mask = slots.size() - 1;
+	auto i = hash & mask;
+	while (slots[i].index != EmptySlot)
+		i = (i + 1) & mask;
+	slots[i] = { index, hash };
+}
+
+void Json::ObjectStorage::Rehash()
+{
+	slots.assign(SlotCount(entries.size()), { EmptySlot, 0 });
+	for (size_t i = 0; i < entries.size(); i++)
+		InsertSlot((uint32_t)i, entries[i].first.Hash());
+}
+
+//Switches a flat object to the indexed layout, a sorted object has to be in key order when this is called
+void Json::ObjectStorage::BuildIndex()
+{
+	Rehash();
+	if (order != ObjectOrder::Sorted)
+		return;
+	sorted.resize(entries.size());
+	for (size_t i = 0; i < sorted.size(); i++)
+		sorted[i] = (uint32_t)i;
+}
+
+//Drops the index and moves the entries back into iteration order
+void Json::ObjectStorage::Flatten()
+{
+	if (!sorted.empty())
+	{
+		std::pmr::vector<value_type> flat(entries.get_allocator());
+		flat.reserve(entries.size());
+		for (const auto index : sorted)
+			flat.emplace_back(std::move(entries[index]));
+		entries.swap(flat);
+	}
+	sorted.clear();
+	slots.clear();
+}
+
+bool Json::Key::operator==(const Key& other) const
+{
+	return data == other.data || (data->hash == other.data->hash && View() == other.View());
+}
+
+bool Json::Key::operator!=(const Key& other) const
+{
+	return !(*this == other);
+}
+
+uint32_t Json::Key::HashOf(std::string_view key)
+{
+	const auto hash = std::hash<std::string_view>()(key);
+	return (uint32_t)(hash ^ (hash >> 32));
+}
+
+Json::Key Json::Key::Create(std::string_view key, const uint32_t hash, std::pmr::memory_resource* resource, const uint32_t refs)
+{
+	void* memory = resource->allocate(Size(key.length()), alignof(Data));
+	auto data = new (memory) Data{ {refs}, hash, (uint32_t)key.length(), {} };
+	memcpy(data->chars, key.data(), key.length());
+	data->chars[key.length()] = '\0';
+	return Key(data);
+}
+
+size_t Json::Key::Size(const size_t length)
+{
+	return std::max(sizeof(Data), offsetof(Data, chars) + length + 1);
+}
+
+void Json::Key::Retain() const
+{
+	if (data && data->refs.load(std::memory_order_relaxed) != 0)
+		data->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Json::Key::Release() const noexcept
+{
+	if (!data || data->refs.load(std::memory_order_relaxed) == 0)
+		return;
+	if (data->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		HeapResource()->deallocate(const_cast<Data*>(data), Size(data->length), alignof(Data));
+}
+
+Json::KeyPool::KeyPool(std::pmr::memory_resource* resource, const bool bCounted)
+	:resource(resource), bCounted(bCounted)
+{
+}
+
+Json::KeyPool::~KeyPool()
+{
+	if (!bCounted)
+		return;
+	for (const auto data : slots)
+		Key(data).Release();
+}
+
+Json::Key Json::KeyPool::Intern(std::string_view key)
+{
+	return Intern(key, Key::HashOf(key));
+}
+
+Json::Key Json::KeyPool::Intern(std::string_view key, const uint32_t hash)
+{
+	if ((count + 1) * 2 > slots.size())
+	{
+		std::vector<const Key::Data*> grown(std::max<size_t>(64, slots.size() * 2), nullptr);
+		const auto mask = grown.size() - 1;
+		for (const auto data : slots)
+		{
+			if (!data)
+				continue;
+			auto i = data->hash & mask;
+			while (grown[i])
+				i = (i + 1) & mask;
+			grown[i] = data;
+		}
+		slots.swap(grown);
+	}
+
+	const auto mask = slots.size() - 1;
+	auto i = hash & mask;
+	for (; slots[i]; i = (i + 1) & mask)
+	{
+		const Key found(slots[i]);
+		if (found.Hash() == hash && found.View() == key)
+		{
+			found.Retain();
+			return found;
+		}
+	}
+	//A counted pool keeps the first reference and hands out the second
+	const auto created = Key::Create(key, hash, resource, bCounted ? 2 : 0);
+	slots[i] = created.data;
+	count++;
+	return created;
+}
+
+Json::Arena::Arena(const size_t initialSize)
+	:monotonic_buffer_resource(initialSize), keys(this, false)
+{
+}
+
+Json::Arena::Arena(void* buffer, const size_t size)
+	:monotonic_buffer_resource(buffer, size), keys(this, false)
+{
+}
+
+//Before the base hands back the blocks the slots were in
+Json::Arena::~Arena()
+{
+	arenasReleased.fetch_add(1, std::memory_order_release);
 }
 
-auto Json::begin() const -> Iterator
+Json::KeyPool* Json::PoolOf(std::pmr::memory_resource* resource)
 {
-	if (GetType() == Json::Type::Array)
-		return Iterator(this, var_->arrayVal->begin());
-	else
-		return Iterator(this, var_->objectVal->begin());
+	const auto arena = dynamic_cast<Arena*>(resource);
+	return arena ? &arena->keys : nullptr;
 }
 
-auto Json::end() const -> Iterator
+//Hands out a key for an object in another tree: interned in the target document, or shared on the heap
+Json::Key Json::ShareKey(const Key& key, KeyPool* pool)
 {
-	if (GetType() == Json::Type::Array)
-		return Iterator(this, var_->arrayVal->end());
-	else
-		return Iterator(this, var_->objectVal->end());
+	if (pool)
+		return pool->Intern(key.View(), key.Hash());
+	if (key.data->refs.load(std::memory_order_relaxed) == 0)
+		return Key::Create(key.View(), key.Hash(), HeapResource(), 1);
+	key.Retain();
+	return key;
 }
 
-const std::string Json::Stringify()
+struct Json::ArrayStorage::Aside
 {
-	std::string result;
-	switch (GetType())
-	{
-	case Type::Null:
-		result += "null";
-		break;
-	case Type::Int:
-		for (const auto &ch: std::to_string(var_->intVal))
-		{
-			result.push_back(ch);
-		}	
-		break;
-	case Type::Float:
-		for (const auto& ch : std::to_string(var_->floatVal))
-		{
-			result.push_back(ch);
-		}
-		break;
-	case Type::Bool:
+	Json value;
+	uint32_t index{ 0 };
+	bool bHeld{ false };
+};
+
+//Header of a block holding an element for each number of a packed array, padded so that they follow it aligned
+struct alignas(Json) Json::ArrayStorage::Copies
+{
+	uint32_t count{ 0 };
+	bool bWritten{ false };	//Handed out through a non-const reference, so they may no longer match the numbers
+	Json* Elements() { return reinterpret_cast<Json*>(this + 1); }
+	const Json* Elements() const { return reinterpret_cast<const Json*>(this + 1); }
+};
+
+namespace
+{
+	template<typename T>
+	constexpr Json::Type PackingOf()
 	{
-		for (const auto& ch : std::string(var_->boolVal ? "true":"false"))
-		{
-			result.push_back(ch);
-		}
-		break;
-	}
-	case Type::String:
-		result.push_back('\"');
-		for (const auto ch : *var_->stringVal)
-		{
-			result.push_back(ch);
-		}
-		result.push_back('\"');
-		break;
-	case Type::Array:
-		result.push_back('[');
-		for (auto val : *var_->arrayVal)
-		{
-			const auto encVal = val.Stringify();
-			result += encVal;
-			result.push_back(',');
-		}
-		if (result[result.length() - 1] == ',')
-			result.pop_back();
-		result.push_back(']');
-		break;
-	case Type::Object:
-		result.push_back('{');
-		for (auto& obj : *var_->objectVal)
-		{
-			result += '\"'+obj.first+'\"'+':';
-			result += obj.second.Stringify();
-			result.push_back(',');
-		}
-		if (result[result.length()-1] == ',')
-			result.pop_back();
-		result.push_back('}');
-		break;
-	default:
-		break;
+		static_assert(std::is_same_v<T, int> || std::is_same_v<T, int64_t> || std::is_same_v<T, float> || std::is_same_v<T, double>, "Arrays only pack int, int64_t, float and double");
+		return std::is_same_v<T, int> ? Json::Int : std::is_same_v<T, int64_t> ? Json::Int64 : std::is_same_v<T, float> ? Json::Float : Json::Double;
 	}
-	return result;
 }
 
-Json Json::Parse(const std::string& js)
+Json::ArrayStorage::ArrayStorage(const allocator_type& allocator)
+	:resource(allocator.resource())
 {
-	Json result;
-	const auto beg = Json::FindFirstNotOf(js, WHITESPACE_CHARS, true);
-	const auto end = Json::FindFirstNotOf(js, WHITESPACE_CHARS, false) + 1;
-	const std::string fixed(js.begin() + beg, js.begin() + end);
-	const auto ch = fixed[0];
-	const auto chL = fixed[fixed.length() - 1];
-
-	std::string str{};
-	if (fixed.length() > 1)
-		str = std::string(fixed.begin() + 1, fixed.end() - 1);
-	else str = ch;
-
-	switch (ch)
-	{
-		case '{': if (chL == '}') result.var_->ParseAsObject(str); break;	
-		case '[': if (chL == ']') result.var_->ParseAsArray(str); break;		
-		case '"': if (chL == '"' && js.length() > 1) 
-			result.var_->type = Type::String; 
-			result.var_->stringVal = new std::string(str); break;		
-		default:
-		if (fixed == "true")
-		{
-			result.var_->type = Type::Bool;
-			result.var_->boolVal = true;
-		}
-		else if (fixed == "false")
-		{
-			result.var_->type = Type::Bool;
-			result.var_->boolVal = false;
-		}
-		else if (fixed == "null")
-		{
-			result.var_->type = Type::Null;
-		}
-		else if (fixed.find_first_of('.') != UINT32_MAX)
-		{
-			result.var_->ParseAsFloat(fixed);
-		}
-		else
-			result.var_->ParseAsInt(fixed);
-		break;
-	}
-	return result;
 }
 
-Json& Json::operator=(const Json& other)
+Json::ArrayStorage::ArrayStorage(ArrayStorage&& other, const allocator_type& allocator)
+	:resource(allocator.resource())
 {
-	//assert(GetType() == other.GetType());
-	if (this != &other)
+	other.Settle();
+	if (other.resource == resource)
 	{
-		var_.reset(new Var());
-		var_->Copy(other.var_);
+		std::swap(data, other.data);
+		std::swap(count, other.count);
+		std::swap(capacity, other.capacity);
+		std::swap(packing, other.packing);
+		return;
 	}
-	return *this;
+	if (CopyPacked(other))
+		return;
+	reserve(other.count);
+	for (uint32_t i = 0; i < other.count; i++)
+		new (Elements() + i) Json(std::move(other.Elements()[i]));
+	count = other.count;
 }
 
-Json& Json::operator=(Json&& other) noexcept
+Json::ArrayStorage::~ArrayStorage()
 {
-	//assert(GetType() == other.GetType());
-	if (this != &other)
-		var_ = std::move(other.var_);
-	return *this;
+	DropCopies();
+	if (aside)
+	{
+		aside->~Aside();
+		resource->deallocate(aside, sizeof(Aside), alignof(Aside));
+	}
+	if (packing == Type::Null)
+		std::destroy(Elements(), Elements() + count);
+	if (data)
+		resource->deallocate(data, capacity * Width(), alignof(Json));
 }
 
-Json& Json::operator[](const std::string& key)
+//The copies of a packed array take the place of its elements, so the element kept aside is written into them first
+auto Json::ArrayStorage::begin() -> iterator
 {
-	assert(GetType() == Type::Object);
-	const auto it = var_->objectVal->find(key);
-	const auto end = var_->objectVal->end();
+	if (packing == Type::Null)
+		return Elements();
+	if (aside && aside->bHeld)
+		Settle();
+	return packing == Type::Null ? Elements() : Written();
+}
 
-	assert(it != end);
-	return it->second;
+auto Json::ArrayStorage::end() -> iterator
+{
+	return begin() + count;
 }
 
-const Json& Json::operator[](const std::string& key) const
+auto Json::ArrayStorage::begin() const -> const_iterator
 {
-	assert(GetType() == Type::Object);
-	const auto it = var_->objectVal->find(key);
-	const auto end = var_->objectVal->end();
-	if (it != end)
-		return it->second;
+	return const_iterator(this, 0);
 }
 
-Json& Json::operator[](const char* key)
+auto Json::ArrayStorage::end() const -> const_iterator
 {
-	return (*this)[std::string(key)];
+	return const_iterator(this, count);
 }
 
-const Json& Json::operator[](const char* key) const
+Json& Json::ArrayStorage::operator[](const size_t i)
 {
-	return (*this)[std::string(key)];
+	if (packing == Type::Null)
+		return Elements()[i];
+	if (Held(i))
+		return aside->value;
+	return Written()[i];
 }
 
-bool Json::operator==(const Json& other) const
+const Json& Json::ArrayStorage::operator[](const size_t i) const
 {
-	if (GetType() != other.GetType())
-		return false;
-	switch (GetType())
-	{
-		case Type::Bool:	return var_->boolVal == other.var_->boolVal;
-		case Type::Int:		return var_->intVal == other.var_->intVal;
-		case Type::Float:	return var_->floatVal == other.var_->floatVal;
-		case Type::String:	return *var_->stringVal == *other.var_->stringVal;
-		case Type::Array:	return Compare(*var_->arrayVal, *other.var_->arrayVal);
-		case Type::Object:	return Compare(*var_->objectVal, *other.var_->objectVal);
-		default:			return true;
-	}
+	if (packing == Type::Null)
+		return Elements()[i];
+	if (const auto* held = Held(i))
+		return *held;
+	return Copied()[i];
 }
 
-bool Json::operator!=(const Json& other) const
+size_t Json::ArrayStorage::size() const
 {
-	return !(*this==other);
+	return count;
 }
 
-const Json& Json::operator[](size_t i) const
+bool Json::ArrayStorage::empty() const
 {
-	assert(GetType() == Type::Array);
-	return (*var_->arrayVal)[i];
+	return count == 0;
 }
 
-const Json& Json::operator[](int i) const
+void Json::ArrayStorage::reserve(const size_t count)
 {
-	return (*this)[(size_t)i];
+	if (count > capacity)
+		Reallocate(count);
 }
 
-Json& Json::operator[](size_t i)
+auto Json::ArrayStorage::get_allocator() const -> allocator_type
 {
-	assert(GetType() == Type::Array);
-	return (*var_->arrayVal)[i];
+	return allocator_type(resource);
 }
 
-Json& Json::operator[](int i)
+Json::Type Json::ArrayStorage::GetPacking() const
 {
-	return (*this)[(size_t)i];
+	return (Type)packing;
 }
 
-Json::operator bool() const
+template<typename T>
+const T* Json::ArrayStorage::Numbers() const
 {
-	if (GetType() != Type::Bool)
-		return false;
-	return var_->boolVal;
+	return packing == PackingOf<T>() && Exact() ? static_cast<const T*>(data) : nullptr;
 }
 
-Json::operator int() const
+template<typename T>
+T* Json::ArrayStorage::Numbers()
 {
-	if (GetType() != Type::Int)
-		return 0;
-	return var_->intVal;
+	Settle();
+	return packing == PackingOf<T>() ? static_cast<T*>(data) : nullptr;
 }
 
-Json::operator float() const
+Json Json::ArrayStorage::Get(const size_t i) const
 {
-	if (GetType() != Type::Float)
-		return 0.f;
-	return var_->floatVal;
+	if (packing == Type::Null)
+		return Elements()[i];
+	if (const auto* held = Held(i))
+		return *held;
+	if (const auto* copied = copies.load(std::memory_order_acquire); copied && copied->bWritten)
+		return Copied()[i];
+	Json val;
+	Load(i, val);
+	return val;
 }
 
-Json::operator std::string() const
+template<typename Visit>
+void Json::ArrayStorage::ForEach(Visit&& visit) const
 {
-	if (GetType() != Type::String)
-		return std::string("");
-	return *var_->stringVal;
+	if (packing == Type::Null)
+		for (uint32_t i = 0; i < count; i++)
+			visit(Elements()[i]);
+	else
+		for (uint32_t i = 0; i < count; i++)
+			visit(Get(i));
 }
 
+Json& Json::ArrayStorage::emplace_back()
+{
+	Unpack();
+	Grow(count + 1);
+	return *new (Elements() + count++) Json();
+}
 
-bool Json::operator==(Json& other)
+Json& Json::ArrayStorage::Insert(const size_t index, Json&& val)
 {
-	if (GetType() != other.GetType())
-						return false;
-	switch (GetType())
+	assert(index <= count);
+	Settle();
+	if (Pack(index, val))
 	{
-	case Type::Bool:	return var_->boolVal == other.var_->boolVal;
-	case Type::Int:		return var_->intVal == other.var_->intVal;
-	case Type::Float:	return var_->floatVal == other.var_->floatVal;
-	case Type::String:	return *var_->stringVal == *other.var_->stringVal;
-	case Type::Array:	return Compare(*var_->arrayVal, *other.var_->arrayVal);
-	case Type::Object:	return Compare(*var_->objectVal, *other.var_->objectVal);
-	default:			return true;
+		if (!aside)
+			aside = new (resource->allocate(sizeof(Aside), alignof(Aside))) Aside();
+		aside->value = std::move(val);
+		aside->index = (uint32_t)index;
+		aside->bHeld = true;
+		return aside->value;
 	}
+	if (index == count)
+		return emplace_back() = std::move(val);
+	Unpack();
+	Grow(count + 1);
+	auto* elements = Elements();
+	new (elements + count) Json(std::move(elements[count - 1]));
+	std::move_backward(elements + index, elements + count - 1, elements + count);
+	count++;
+	return elements[index] = std::move(val);
 }
 
-bool Json::operator!=(Json& other)
+void Json::ArrayStorage::Push(Json&& val)
 {
-	return !(*this == other);
+	Settle();
+	if (!Pack(count, val))
+		emplace_back() = std::move(val);
 }
 
-Json& Json::Insert(const Json& val, const size_t index)
+void Json::ArrayStorage::Append(ArrayStorage&& other)
 {
-	assert(GetType() == Type::Array);
-	const auto	beg = var_->arrayVal->begin();
-	const auto	result = var_->arrayVal->insert(beg + index, val);
-	return		*result;
+	Settle();
+	other.Settle();
+	if (other.packing != Type::Null && (other.packing == packing || (count == 0 && packing == Type::Null)))
+	{
+		if (packing != other.packing)
+			Repack(other.GetPacking());
+		Grow(count + other.count);
+		memcpy(Bytes() + count * Width(), other.Bytes(), other.count * Width());
+		count += other.count;
+		return;
+	}
+	Unpack();
+	Grow(count + other.count);
+	for (uint32_t i = 0; i < other.count; i++)
+		new (Elements() + count++) Json(other.packing == Type::Null ? std::move(other.Elements()[i]) : other.Get(i));
 }
 
-Json& Json::Insert(Json&& val, const size_t index)
+Json Json::ArrayStorage::Remove(const size_t index)
 {
-	assert(GetType() == Type::Array);
-	const auto	beg = var_->arrayVal->begin();
-	auto		result = var_->arrayVal->insert(beg + var_->arrayVal->size(), std::move(val));
-	return		*result;
+	assert(index < count);
+	Settle();
+	if (packing != Type::Null)
+	{
+		auto removed = Get(index);
+		const auto width = Width();
+		memmove(Bytes() + index * width, Bytes() + (index + 1) * width, (count - index - 1) * width);
+		count--;
+		return removed;
+	}
+	auto* elements = Elements();
+	auto removed = std::move(elements[index]);
+	std::move(elements + index + 1, elements + count, elements + index);
+	elements[--count].~Json();
+	return removed;
 }
 
-Json& Json::Add(const Json& val)
+bool Json::ArrayStorage::CopyPacked(const ArrayStorage& src)
 {
-	assert(GetType() == Type::Array);
-	auto&	result = Insert(val, var_->arrayVal->size());
-	return	result;
+	assert(count == 0);
+	if (src.packing == Type::Null || !src.Exact())
+		return false;
+	Repack(src.GetPacking());
+	if (src.count > capacity)
+		Reallocate(src.count);
+	memcpy(data, src.data, src.count * Width());
+	count = src.count;
+	return true;
 }
 
-Json& Json::Add(Json&& val)
+void Json::ArrayStorage::Settle()
 {
-	if (this == &val)
-		return Add(val);
-	assert(GetType() == Type::Array);
-	auto	&result = Insert(std::move(val), var_->arrayVal->size());
-	return	result;
+	if (auto* copied = copies.load(std::memory_order_relaxed); copied && copied->bWritten)
+	{
+		const auto* written = copied->Elements();
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (written[i].GetType() != packing && !Held(i))
+			{
+				Unpack();
+				return;
+			}
+		}
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (!Held(i))
+				Store(i, written[i]);
+		}
+	}
+	DropCopies();
+	if (aside && aside->bHeld)
+	{
+		if (aside->value.GetType() != packing)
+		{
+			Unpack();
+			return;
+		}
+		Store(aside->index, aside->value);
+		aside->bHeld = false;
+	}
 }
 
-std::vector<std::string> Json::GetKeys() const
+bool Json::ArrayStorage::Packs(const Type type)
 {
-	std::vector<std::string> keys;
-	if (GetType() == Type::Object)
+	return type == Type::Int || type == Type::Int64 || type == Type::Float || type == Type::Double;
+}
+
+size_t Json::ArrayStorage::Width() const
+{
+	switch (packing)
 	{
-		for (const auto& key : *var_->objectVal)
-			keys.push_back(key.first);		
-		return keys;
+	case Type::Null:	return sizeof(Json);
+	case Type::Int:
+	case Type::Float:	return 4;
+	default:			return 8;
 	}
 }
 
-void Json::Var::Copy(const std::unique_ptr<Var>& src)
+char* Json::ArrayStorage::Bytes() const
 {
-	type = src->type;
-	switch (type)
+	return static_cast<char*>(data);
+}
+
+Json* Json::ArrayStorage::Elements() const
+{
+	return static_cast<Json*>(data);
+}
+
+//The element kept aside if it is element i
+const Json* Json::ArrayStorage::Held(const size_t i) const
+{
+	return aside && aside->bHeld && aside->index == i ? &aside->value : nullptr;
+}
+
+//Element i, or for a packed array the copy written through or one of its number made in copy, which has room for a Json
+const Json& Json::ArrayStorage::Element(const size_t i, void* copy) const
+{
+	if (packing == Type::Null)
+		return Elements()[i];
+	if (const auto* held = Held(i))
+		return *held;
+	if (const auto* copied = copies.load(std::memory_order_acquire); copied && copied->bWritten)
+		return Copied()[i];
+	auto* val = new (copy) Json();
+	Load(i, *val);
+	return *val;
+}
+
+//Elements copied from the numbers of a packed array, at addresses that stay put until the array next changes. They go on the
+//heap, which const readers on several threads can allocate from at once; if two race to make them the first made is kept
+Json* Json::ArrayStorage::Copied() const
+{
+	auto* current = copies.load(std::memory_order_acquire);
+	if (current)
+		return current->Elements();
+	auto* made = new (HeapResource()->allocate(sizeof(Copies) + count * sizeof(Json), alignof(Json))) Copies();
+	made->count = count;
+	for (uint32_t i = 0; i < count; i++)
+		Load(i, *new (made->Elements() + i) Json());
+	if (copies.compare_exchange_strong(current, made, std::memory_order_acq_rel, std::memory_order_acquire))
+		return made->Elements();
+	HeapResource()->deallocate(made, sizeof(Copies) + made->count * sizeof(Json), alignof(Json));
+	return current->Elements();
+}
+
+//The copies handed out through a non-const reference, which may then be written through
+Json* Json::ArrayStorage::Written()
+{
+	auto* elements = Copied();
+	copies.load(std::memory_order_relaxed)->bWritten = true;
+	return elements;
+}
+
+//Copies of numbers hold nothing to destroy, those written through may hold anything
+void Json::ArrayStorage::DropCopies()
+{
+	auto* dropped = copies.exchange(nullptr, std::memory_order_acquire);
+	if (!dropped)
+		return;
+	if (dropped->bWritten)
+		std::destroy(dropped->Elements(), dropped->Elements() + dropped->count);
+	HeapResource()->deallocate(dropped, sizeof(Copies) + dropped->count * sizeof(Json), alignof(Json));
+}
+
+//Whether the numbers hold the element kept aside and the copies written through as they are now
+bool Json::ArrayStorage::Exact() const
+{
+	const auto matches = [this](const Json& val, const size_t i)
 	{
-	case Json::Bool:
-		boolVal = src->boolVal;
-		break;
-	case Json::Int:
-		intVal = src->intVal;
-		break;
-	case Json::Float:
-		floatVal = src->floatVal;
-		break;
-	case Json::String:
-		stringVal = new std::string(*src->stringVal);
-		break;
-	case Json::Array:
-		arrayVal = new std::vector<Json>;
-		arrayVal->reserve(src->arrayVal->size());
-		for (const auto& srcElements : *src->arrayVal)
-			arrayVal->emplace_back(srcElements);		
-		break;
-	case Json::Object:
-		objectVal = new std::map<std::string, Json>;
-		for (const auto& srcElement : *src->objectVal)
-			objectVal->insert({srcElement.first, srcElement.second});		
-		break;
-	default:
-		break;
+		return val.GetType() == packing && memcmp(Bytes() + i * Width(), &val.var_.int64Val, Width()) == 0;
+	};
+	if (aside && aside->bHeld && !matches(aside->value, aside->index))
+		return false;
+	const auto* copied = copies.load(std::memory_order_acquire);
+	if (!copied || !copied->bWritten)
+		return true;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (!Held(i) && !matches(copied->Elements()[i], i))
+			return false;
 	}
+	return true;
 }
 
-std::string Json::Var::RemoveWS(const std::string& text)
+//Puts val in as a number at index if it is one of the type the array packs. Arrays of elements pack once val makes PackFrom
+//numbers of one type, and empty packed arrays take whatever type comes next
+bool Json::ArrayStorage::Pack(const size_t index, const Json& val)
 {
-	std::string result{ "" };
-	for (size_t i = 0; i < text.length(); i++)
+	const auto type = val.GetType();
+	if (!Packs(type))
+		return false;
+	if (packing == Type::Null)
 	{
-		const auto& ch = text[i];
-		if (WHITESPACE_CHARS.find(ch) == WHITESPACE_CHARS.end())
-			continue;
-		result += ch;
+		if (count + 1 != PackFrom || std::any_of(Elements(), Elements() + count, [type](const Json& element) { return element.GetType() != type; }))
+			return false;
+		PackElements(type);
 	}
-	return result;
+	else if (count == 0)
+		Repack(type);
+	if (type != packing)
+		return false;
+	Grow(count + 1);
+	const auto width = Width();
+	if (index < count)
+		memmove(Bytes() + (index + 1) * width, Bytes() + index * width, (count - index) * width);
+	Store(index, val);
+	count++;
+	return true;
 }
 
-void Json::Var::ParseAsInt(const std::string& text)
+//Switches an empty array to holding numbers of another type, or elements, keeping its buffer if it divides up evenly
+void Json::ArrayStorage::Repack(const Type newPacking)
 {
-	int val{ 0 }; size_t bNegative = text[0] == '-';
-	for (size_t i = bNegative; i < text.length(); i++)
+	assert(count == 0);
+	const size_t bytes = capacity * Width();
+	packing = newPacking;
+	if (bytes % Width() == 0)
 	{
-		const auto& ch = text[i];
-		assert(ch >= '0' && ch <= '9');
-		val *= 10;
-		val += ch - 48;
+		capacity = (uint32_t)(bytes / Width());
+		return;
 	}
-	if (bNegative)
-		val *= -1;
-	type = Type::Int;
-	intVal = val;
+	resource->deallocate(data, bytes, alignof(Json));
+	data = nullptr;
+	capacity = 0;
+}
+
+//Sizes known to the compiler, so each is a single move
+void Json::ArrayStorage::Store(const size_t index, const Json& val)
+{
+	if (Width() == 4)
+		memcpy(Bytes() + index * 4, &val.var_.int64Val, 4);
+	else
+		memcpy(Bytes() + index * 8, &val.var_.int64Val, 8);
+}
+
+//Puts number i into val, which holds nothing
+void Json::ArrayStorage::Load(const size_t i, Json& val) const
+{
+	val.var_.type = packing;
+	if (Width() == 4)
+		memcpy(&val.var_.int64Val, Bytes() + i * 4, 4);
+	else
+		memcpy(&val.var_.int64Val, Bytes() + i * 8, 8);
+}
+
+//Numbers hold nothing to destroy, and each one moves down over those before it within the same buffer
+void Json::ArrayStorage::PackElements(const Type type)
+{
+	const size_t bytes = capacity * sizeof(Json);
+	const auto* elements = Elements();
+	packing = type;
+	const auto width = Width();
+	for (uint32_t i = 0; i < count; i++)
+		memmove(Bytes() + i * width, &elements[i].var_.int64Val, width);
+	capacity = (uint32_t)(bytes / width);
 }
 
-void Json::Var::ParseAsFloat(const std::string& text)
+void Json::ArrayStorage::Grow(const size_t needed)
 {
-	type = Type::Float;
-	floatVal = (float)atof(text.c_str());
+	if (needed > capacity)
+		Reallocate(std::max<size_t>(needed, 2 * (size_t)capacity));
 }
 
-void Json::Var::ParseAsObject(const std::string& text)
+void Json::ArrayStorage::Reallocate(const size_t newCapacity)
 {
-	std::map<std::string, Json> result;
-	size_t offset{ 0 };
-	while (offset < text.length())
+	assert(newCapacity >= count && newCapacity <= UINT32_MAX);
+	const auto width = Width();
+	auto* newData = resource->allocate(newCapacity * width, alignof(Json));
+	if (packing != Type::Null && count > 0)
+		memcpy(newData, data, count * width);
+	else if (packing == Type::Null)
 	{
-		const auto encKey = ParseKV(text, offset, ':');	
-		if (encKey.empty())
-			return;
-		const auto key = Json::Parse(encKey);
-		assert(key.GetType() == Type::String);
-		const auto encVal = ParseKV(text, offset, ',');
-		if (encVal.empty())
-			return;
-		result[(std::string)key] = Json::Parse(encVal);
-	};
-	type = Type::Object;
-	objectVal = new decltype(result)(result);
+		std::uninitialized_move(Elements(), Elements() + count, static_cast<Json*>(newData));
+		std::destroy(Elements(), Elements() + count);
+	}
+	if (data)
+		resource->deallocate(data, capacity * width, alignof(Json));
+	data = newData;
+	capacity = (uint32_t)newCapacity;
 }
 
-void Json::Var::ParseAsArray(const std::string& text)
+//Copies written through move over as they are, they were copied in with the array's resource
+void Json::ArrayStorage::Unpack()
 {
-	std::vector<Json> result;
-	size_t offset{ 0 };
-	while (offset< text.length())
+	if (packing == Type::Null)
+		return;
+	auto* elements = static_cast<Json*>(resource->allocate(count * sizeof(Json), alignof(Json)));
+	auto* copied = copies.load(std::memory_order_relaxed);
+	for (uint32_t i = 0; i < count; i++)
 	{
-		const auto encVal = ParseKV(text, offset, ',');
-		if (encVal.empty())
-			return;
-		result.emplace_back(Json::Parse(encVal));
+		if (copied && copied->bWritten)
+			new (elements + i) Json(std::move(copied->Elements()[i]));
+		else
+			new (elements + i) Json(Get(i));
 	}
-	type = Type::Array;
-	arrayVal = new decltype(result)(result);
+	DropCopies();
+	if (aside && aside->bHeld)
+	{
+		elements[aside->index] = std::move(aside->value);
+		aside->value = Json();
+		aside->bHeld = false;
+	}
+	if (data)
+		resource->deallocate(data, capacity * Width(), alignof(Json));
+	data = elements;
+	capacity = count;
+	packing = Type::Null;
 }
 
-std::string Json::Var::ParseKV(const std::string& text, size_t& offset, const char delimiter)
+static_assert(sizeof(Json) <= 16 && alignof(Json) <= 8, "ArrayStorage::const_iterator has room for a 16 byte Json");
+
+Json::ArrayStorage::const_iterator::const_iterator(const ArrayStorage* array, const size_t index)
+	:array(array), index(index)
 {
-	std::stack<char> deli;
-	std::string encoded;
-	std::string encoding(text.begin() + offset, text.end());
+}
 
-	for (const auto cp : encoding)
-	{
-		encoded.push_back(cp);
-		if (!deli.empty() && cp == deli.top())
-		{ 
-			deli.pop();
-			continue;
-		}
+//Copies of numbers hold nothing to destroy, so each one is made over the last
+const Json& Json::ArrayStorage::const_iterator::operator*() const
+{
+	return array->Element(index, copy);
+}
 
-		switch (cp)
-		{
-			case '\"':
-				deli.push('\"');
-			break;
-			case '[':
-				deli.push(']');
-			break;
-			case '{':
-				deli.push('}');
-			break;
-			default:			
-			break;
-		}
-		if (cp == delimiter && deli.empty())
-			break;	
-	}
-	assert(deli.empty());
+const Json* Json::ArrayStorage::const_iterator::operator->() const
+{
+	return &**this;
+}
+
+auto Json::ArrayStorage::const_iterator::operator++() -> const_iterator&
+{
+	index++;
+	return *this;
+}
+
+auto Json::ArrayStorage::const_iterator::operator++(int) -> const_iterator
+{
+	auto before = *this;
+	index++;
+	return before;
+}
+
+bool Json::ArrayStorage::const_iterator::operator==(const const_iterator& other) const
+{
+	return index == other.index && array == other.array;
+}
+
+bool Json::ArrayStorage::const_iterator::operator!=(const const_iterator& other) const
+{
+	return !(*this == other);
+}
 
-	offset += encoded.length();
-	if (encoded.back() == delimiter)
-		encoded.pop_back();
+template<typename T>
+auto Json::Numbers() const -> Span<const T>
+{
+	const auto* numbers = GetType() == Type::Array ? static_cast<const ArrayStorage*>(var_.arrayVal)->Numbers<T>() : nullptr;
+	return numbers ? Span<const T>{ numbers, Size() } : Span<const T>{};
+}
 
-	return encoded;
+template<typename T>
+auto Json::Numbers() -> Span<T>
+{
+	if (GetType() != Type::Array || var_.arrayVal->GetPacking() != PackingOf<T>())
+		return {};
+	var_.Detach();
+	auto* numbers = var_.arrayVal->Numbers<T>();
+	return numbers ? Span<T>{ numbers, Size() } : Span<T>{};
 }
 
-Json::Iterator::Iterator(const Json* obj, std::vector<Json>::const_iterator&& nextArrayEntry)
+template Json::Span<const int> Json::Numbers<int>() const;
+template Json::Span<const int64_t> Json::Numbers<int64_t>() const;
+template Json::Span<const float> Json::Numbers<float>() const;
+template Json::Span<const double> Json::Numbers<double>() const;
+template Json::Span<int> Json::Numbers<int>();
+template Json::Span<int64_t> Json::Numbers<int64_t>();
+template Json::Span<float> Json::Numbers<float>();
+template Json::Span<double> Json::Numbers<double>();
+
+Json::Iterator::Iterator(const Json* obj, ArrayStorage::const_iterator&& nextArrayEntry)
 	:container(obj), nextArrayEntry(nextArrayEntry)
 {
 }
-Json::Iterator::Iterator(const Json* obj, std::map<std::string, Json>::const_iterator&& nextObjectEntry)
+Json::Iterator::Iterator(const Json* obj, ObjectStorage::const_iterator&& nextObjectEntry)
 	: container(obj), nextObjectEntry(nextObjectEntry)
 {
 }
@@ -852,11 +5538,19 @@ Json::Iterator& Json::Iterator::operator*()
 }
 
 const std::string& Json::Iterator::Key() const
+{
+	//Reuses the buffer of the last key, so walking an object only allocates for a key longer than any before it
+	const auto view = KeyView();
+	key.assign(view.data(), view.length());
+	return key;
+}
+
+std::string_view Json::Iterator::KeyView() const
 {
 	if (container->GetType() == Type::Array)
-		return *nextArrayEntry;
+		return nextArrayEntry->GetType() == Type::String ? nextArrayEntry->var_.Str() : std::string_view();
 	else
-		return nextObjectEntry->first;
+		return nextObjectEntry->first.View();
 }
 
 const Json& Json::Iterator::Value() const
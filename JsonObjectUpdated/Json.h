@@ -1,13 +1,21 @@
 #pragma once
-//For now the only supported format is Ascii2
+//Text is read and written as Ascii2, MessagePack is supported as a binary alternative
 #include <memory>
+#include <cstdint>
+#include <cstddef>
 #include <vector>
 #include <string>
 #include <map>
-#include <set>
+#include <iosfwd>
+#include <string_view>
+#include <memory_resource>
+#include <atomic>
+#include <optional>
+#include <functional>
 #include <assert.h>
 #include <initializer_list>
-#include <stack>
+
+class MappedFile;
 
 class Json
 {
@@ -19,23 +27,360 @@ private:
 	};
 
 public:
-	enum Type { Null, Bool, Int, Float, String, Array, Object };
+	enum Type { Null, Bool, Int, Float, String, Array, Object, Int64, Double };
+	enum class LoadMode { Mapped, Buffered };
+	enum class Format { Text, MessagePack };
+	enum class ObjectOrder { Sorted, Insertion };
+	//Contiguous run of values, until the project moves to C++20 and std::span
+	template<typename T>
+	struct Span
+	{
+		T* data = nullptr;
+		size_t size = 0;
+
+		T* begin() const { return data; }
+		T* end() const { return data + size; }
+		T& operator[](const size_t i) const { return data[i]; }
+		bool empty() const { return size == 0; }
+	};
+
+	//How Parse and Stringify split a large document between threads
+	struct ParallelOptions
+	{
+		unsigned threads = 0;					//Zero uses one per hardware thread
+		size_t chunkSize = 1024 * 1024;			//Members are handed out in runs of about this many bytes when parsing,
+												//Stringify splits containers estimated at twice as much or more
+	};
+#ifdef JSON_INSERTION_ORDER
+	static constexpr ObjectOrder DefaultObjectOrder = ObjectOrder::Insertion;
+#else
+	static constexpr ObjectOrder DefaultObjectOrder = ObjectOrder::Sorted;
+#endif
+	class Document;
+	class LazyView;
+	class SnapshotView;
+	class Path;
+	class PathSet;
+	class LineReader;
+	class LineWriter;
+	class PushParser;
+	class Reader;
+
+	//Handle to an interned object key. A document stores each distinct key once and its objects point at it; keys of heap
+	//objects are reference counted and shared by the objects of one parse and by their copies.
+	class Key
+	{
+	public:
+		Key() = default;
+		std::string_view View() const { return std::string_view(data->chars, data->length); }
+		uint32_t Hash() const { return data->hash; }
+		operator std::string_view() const { return View(); }
+		bool operator==(const Key& other) const;
+		bool operator!=(const Key& other) const;
+		static uint32_t HashOf(std::string_view key);
+
+	private:
+		friend class Json;
+		struct Data
+		{
+			mutable std::atomic<uint32_t> refs;	//Zero for keys owned by a document
+			uint32_t hash;
+			uint32_t length;
+			char chars[1];
+		};
+
+		explicit Key(const Data* data) : data(data) {}
+		static Key Create(std::string_view key, const uint32_t hash, std::pmr::memory_resource* resource, const uint32_t refs);
+		static size_t Size(const size_t length);
+		void Retain() const;
+		void Release() const noexcept;
+
+		const Data* data = nullptr;
+	};
+
+	//Flat object storage. Entries live in one vector, sorted by key unless insertion order was asked for.
+	//Above HashThreshold entries an open addressing index from key hash to entry is kept next to them, and a sorted object
+	//appends new keys and keeps the key order as a list of positions instead of shifting the entries.
+	class ObjectStorage
+	{
+	public:
+		using value_type = std::pair<Key, Json>;
+		using allocator_type = std::pmr::polymorphic_allocator<value_type>;
+		static constexpr size_t HashThreshold = 16;
+
+		template<typename Entry>
+		class Cursor
+		{
+		public:
+			Cursor() = default;
+			Cursor(Entry* entries, const uint32_t* positions, const size_t pos)
+				:entries(entries), positions(positions), pos(pos) {}
+
+			Entry& operator*() const { return entries[positions ? positions[pos] : pos]; }
+			Entry* operator->() const { return &**this; }
+			Cursor& operator++() { pos++; return *this; }
+			Cursor operator++(int) { Cursor prev(*this); pos++; return prev; }
+			bool operator==(const Cursor& other) const { return pos == other.pos; }
+			bool operator!=(const Cursor& other) const { return pos != other.pos; }
+
+		private:
+			Entry* entries{ nullptr };
+			const uint32_t* positions{ nullptr };
+			size_t pos{ 0 };
+		};
+		using iterator = Cursor<value_type>;
+		using const_iterator = Cursor<const value_type>;
+
+		explicit ObjectStorage(const allocator_type& allocator);
+		ObjectStorage(const ObjectOrder order, const allocator_type& allocator);
+		ObjectStorage(ObjectStorage&& other, const allocator_type& allocator);
+		ObjectStorage(const ObjectStorage&) = delete;
+		ObjectStorage& operator=(const ObjectStorage&) = delete;
+		~ObjectStorage();
+
+		iterator begin();
+		iterator end();
+		const_iterator begin() const;
+		const_iterator end() const;
+		size_t size() const;
+		bool empty() const;
+		void reserve(const size_t count);
+		allocator_type get_allocator() const;
+		ObjectOrder GetOrder() const;
+
+		Json* Find(std::string_view key);
+		const Json* Find(std::string_view key) const;
+		const Json* Find(const Key& key) const;
+		const Json* Find(std::string_view key, const uint32_t hash) const;
+		Json& InsertOrAssign(std::string_view key, Json&& value);
+		bool Erase(std::string_view key);
+
+		//Appends without looking for duplicates and takes over the caller's reference to the key,
+		//Finalize restores order and uniqueness after a run of appends
+		Json& Append(const Key& key);
+		void Finalize();
+
+	private:
+		struct Slot
+		{
+			uint32_t index;
+			uint32_t hash;
+		};
+		static constexpr uint32_t EmptySlot = UINT32_MAX;
+
+		static size_t SlotCount(const size_t count);
+		size_t FindIndex(std::string_view key) const;
+		size_t FindIndex(std::string_view key, const uint32_t hash, const size_t count) const;
+		size_t LowerBound(std::string_view key) const;
+		size_t SortedBound(std::string_view key) const;
+		void InsertSlot(const uint32_t index, const uint32_t hash);
+		void Rehash();
+		void BuildIndex();
+		void Flatten();
+
+		std::pmr::vector<value_type> entries;
+		std::pmr::vector<Slot> slots;
+		std::pmr::vector<uint32_t> sorted;
+		ObjectOrder order;
+	};
+
+	//Array storage. Once PackFrom elements are in and all are numbers of one type (Int, Int64, Float or Double) they are kept
+	//packed, 4 or 8 bytes each instead of 16, until something else goes in. Smaller arrays are not worth the numbers' extra
+	//bookkeeping.
+	//Const access never changes the numbers of a packed array: iterators copy each number into themselves as they reach it,
+	//and operator[] hands out copies of all of them, made on the heap the first time one is asked for and kept at the same
+	//addresses until the array next changes. Non-const access hands out the same copies, and what is written through them goes
+	//back into the numbers when the array next changes, or unpacks it if a value no longer fits. The element Insert hands back
+	//for a packed number is kept aside until then as well. Reads see both where they are.
+	class ArrayStorage
+	{
+	public:
+		using value_type = Json;
+		using allocator_type = std::pmr::polymorphic_allocator<Json>;
+		using iterator = Json*;
+
+		class const_iterator
+		{
+		public:
+			const_iterator() = default;
+			const_iterator(const ArrayStorage* array, const size_t index);
+			const Json& operator*() const;
+			const Json* operator->() const;
+			const_iterator& operator++();
+			const_iterator operator++(int);
+			bool operator==(const const_iterator& other) const;
+			bool operator!=(const const_iterator& other) const;
+
+		private:
+			const ArrayStorage* array = nullptr;
+			size_t index = 0;
+			alignas(8) mutable unsigned char copy[16];	//Room for a number of a packed array, Json is not complete here
+		};
+
+		explicit ArrayStorage(const allocator_type& allocator);
+		ArrayStorage(ArrayStorage&& other, const allocator_type& allocator);
+		ArrayStorage(const ArrayStorage&) = delete;
+		ArrayStorage& operator=(const ArrayStorage&) = delete;
+		~ArrayStorage();
+
+		iterator begin();
+		iterator end();
+		const_iterator begin() const;
+		const_iterator end() const;
+		Json& operator[](const size_t i);
+		const Json& operator[](const size_t i) const;
+		size_t size() const;
+		bool empty() const;
+		void reserve(const size_t count);
+		allocator_type get_allocator() const;
+
+		//Type of the numbers a packed array holds, Null for any other array
+		Type GetPacking() const;
+		//The numbers of a packed array as T, nullptr if it packs another type or an element kept aside or written through a
+		//copy no longer matches
+		template<typename T>
+		const T* Numbers() const;
+		template<typename T>
+		T* Numbers();
+		//Element i by value, which leaves a packed array packed
+		Json Get(const size_t i) const;
+		//Visits every element, as a temporary for the numbers of a packed array
+		template<typename Visit>
+		void ForEach(Visit&& visit) const;
+		Json& emplace_back();
+		Json& Insert(const size_t index, Json&& val);
+		//Appends val without handing it back, so a packed array needs nothing kept aside
+		void Push(Json&& val);
+		//Moves the elements of other to the end, as numbers if both pack the same type
+		void Append(ArrayStorage&& other);
+		Json Remove(const size_t index);
+		//Copies src's numbers sized to fit, false if src is not packed
+		bool CopyPacked(const ArrayStorage& src);
+		//Writes the element kept aside and the copies written through into the numbers, or unpacks if one no longer fits.
+		//Every change starts with it
+		void Settle();
+
+	private:
+		struct Aside;
+		struct Copies;
+
+		static constexpr uint32_t PackFrom = 8;
+
+		static bool Packs(const Type type);
+		size_t Width() const;
+		char* Bytes() const;
+		Json* Elements() const;
+		const Json* Held(const size_t i) const;
+		const Json& Element(const size_t i, void* copy) const;
+		Json* Copied() const;
+		Json* Written();
+		void DropCopies();
+		bool Exact() const;
+		bool Pack(const size_t index, const Json& val);
+		void Repack(const Type newPacking);
+		void PackElements(const Type type);
+		void Store(const size_t index, const Json& val);
+		void Load(const size_t i, Json& val) const;
+		void Grow(const size_t needed);
+		void Reallocate(const size_t newCapacity);
+		void Unpack();
+
+		std::pmr::memory_resource* resource;
+		void* data = nullptr;						//Elements, or the numbers of a packed array
+		uint32_t count = 0;
+		uint32_t capacity = 0;
+		Aside* aside = nullptr;
+		mutable std::atomic<Copies*> copies{ nullptr };
+		uint8_t packing = Type::Null;
+	};
+
+	//Receives the values of a document in order without building a tree, returning false from any callback stops the parse
+	struct Handler
+	{
+		virtual ~Handler() = default;
+		virtual bool Null() { return true; }
+		virtual bool Bool(const bool) { return true; }
+		virtual bool Int(const int) { return true; }
+		virtual bool Float(const float) { return true; }
+		virtual bool Int64(const int64_t) { return true; }
+		virtual bool Double(const double) { return true; }
+		virtual bool String(std::string_view) { return true; }
+		virtual bool StartObject() { return true; }
+		virtual bool Key(std::string_view) { return true; }
+		virtual bool EndObject() { return true; }
+		virtual bool StartArray() { return true; }
+		virtual bool EndArray() { return true; }
+	};
+
+	//Serializes into one growing string, or into a fixed size buffer that is flushed to a stream or file descriptor whenever it fills up
+	class Writer : public Handler
+	{
+	public:
+		static constexpr size_t ChunkSize = 64 * 1024;
+
+		Writer(std::string& out, const bool bPretty = false);
+		Writer(std::ostream& os, const bool bPretty = false);
+		Writer(const int fd, const bool bPretty = false);
+		Writer(const Writer&) = delete;
+		Writer& operator=(const Writer&) = delete;
+		~Writer() noexcept;
+
+		Writer& Write(const Json& json);
+		void Flush();
+
+		bool Null() override;
+		bool Bool(const bool bval) override;
+		bool Int(const int val) override;
+		bool Float(const float val) override;
+		bool Int64(const int64_t val) override;
+		bool Double(const double val) override;
+		bool String(std::string_view str) override;
+		bool StartObject() override;
+		bool Key(std::string_view key) override;
+		bool EndObject() override;
+		bool StartArray() override;
+		bool EndArray() override;
+
+	private:
+		friend class Json;
+		//Writes members [begin, end) of an array or object as if the ones before them had been written already
+		void WriteRange(const Json& container, const size_t begin, const size_t end);
+		void WriteElements(const ArrayStorage& array, const size_t begin, const size_t end);
+		template<typename Real>
+		void PutReal(const Real val);
+		void BeforeValue();
+		bool AfterValue();
+		void EndContainer(const char close);
+		void NewLine();
+		void PutString(std::string_view str);
+
+		std::ostream* os = nullptr;
+		int fd = -1;
+		std::string buffer;
+		std::string& text;
+		std::vector<size_t> levels;
+		bool bPretty = false;
+		bool bAfterKey = false;
+	};
 
 	struct Iterator
 	{
-		Iterator(const Json* obj, std::vector<Json>::const_iterator&& nextArrayEntry);
-		Iterator(const Json* container, std::map<std::string, Json>::const_iterator&& nextObjectEntry);
+		Iterator(const Json* obj, ArrayStorage::const_iterator&& nextArrayEntry);
+		Iterator(const Json* container, ObjectStorage::const_iterator&& nextObjectEntry);
 		Iterator* operator++();
 		operator size_t() const;
 		bool operator!=(const Iterator& other) const;
 		Iterator& operator*();
+		//Copies the key out of the object, KeyView reads it in place
 		const std::string& Key() const;
+		std::string_view KeyView() const;
 		const Json& Value() const;
 	private:
 		size_t counter{ 0 };
 		const Json* container = nullptr;		
-		std::vector<Json>::const_iterator nextArrayEntry;
-		std::map<std::string, Json>::const_iterator nextObjectEntry;
+		ArrayStorage::const_iterator nextArrayEntry;
+		ObjectStorage::const_iterator nextObjectEntry;
+		mutable std::string key;
 	};
 
 	Json(const Json&);
@@ -44,6 +389,8 @@ public:
 	Json(const bool bval);
 	Json(const int val);
 	Json(const float val);
+	Json(const int64_t val);
+	Json(const double val);
 	Json(const char* str);
 	Json(const std::string& str);
 	template<typename ARG, typename ... R>
@@ -63,6 +410,8 @@ public:
 	bool operator!=(Json& other);
 	bool operator==(const Json& other) const;
 	bool operator!=(const Json& other) const;
+	//The first element asked for of a packed array copies all its numbers into elements, which take 16 bytes each until the
+	//array next changes; Numbers, Get or iteration read them without
 	const Json& operator[](size_t i) const;
 	const Json& operator[](int i) const;
 	Json& operator[](size_t i);
@@ -71,7 +420,11 @@ public:
 	operator bool() const;
 	operator int() const;
 	operator float() const;
+	operator int64_t() const;
+	operator double() const;
 	operator std::string() const;
+	//Views the string without copying it, empty for any other type
+	std::string_view GetString() const;
 
 	Json& Insert(const Json& val, const size_t index);
 	Json& Insert(Json&& val, const size_t index);
@@ -82,76 +435,569 @@ public:
 	const size_t Size() const;
 	Json& Set(const std::string& key, const Json& value);
 	bool Contains(const std::string& key) const;
+	//Moves this tree into reference counted nodes. A copy of a shared node in the same resource takes another reference instead
+	//of copying it, and the non-const accessors, Add, Insert and Set copy a node the first time it is changed while another
+	//value still holds it. Copies then cost O(1) and versions of a tree only pay for the paths they changed.
+	//Values stored through a non-const operator[] stay unshared until Share is called again.
+	void Share();
+	bool IsShared() const;
+	//Numbers of an array packed as T (int, int64_t, float or double), empty for any other value. Parsing, Add and Insert pack
+	//arrays of eight or more elements that are all numbers of one type. The non-const one gives the array storage of its
+	//own first, and writes through it change the array
+	template<typename T>
+	Span<const T> Numbers() const;
+	template<typename T>
+	Span<T> Numbers();
+	//Shared copy of this tree laid out compactly (containers sized to fit, objects flattened and indexed), for handing to
+	//threads that only read it. The const accessors never change a tree, so any number of threads can read one at once and
+	//copies of it cost a reference; a thread that changes its copy gets nodes of its own
+	Json Freeze() const;
+	//Resolves a compiled path without allocating, nullptr if a step is missing or not a container.
+	//The non-const one unshares the nodes along the path so the result can be changed, the const one gives elements of
+	//packed arrays as const operator[] does
+	const Json* Find(const Path& path) const;
+	Json* Find(const Path& path);
+	//Resolves a batch of paths in one walk over the tree, looking up a prefix they share only once. Results follow the order of the paths
+	std::vector<const Json*> FindAll(const PathSet& paths) const;
+	//RFC 6902 patch that turns a into b. Objects are matched by key and arrays by trimming their common ends, so one
+	//inserted or removed element is one operation. Subtrees that two shared versions still have in common are skipped unvisited
+	static Json Diff(const Json& a, const Json& b);
+	//Structural hash, equal values hash the same. Numbers compare and hash by their exact value whichever type holds them,
+	//so 1 equals 1.0 but a Float equals a Double only if widening it gives that double. A shared container keeps its hash
+	//until it is changed, and operator== tells two shared containers apart by their hashes without looking further once
+	//both are known
+	uint64_t Hash() const;
+	//Applies an RFC 6902 patch in place, false as soon as an operation fails with the ones before it left applied.
+	//The rvalue overload moves the values out of the patch instead of copying them
+	bool ApplyPatch(const Json& patch);
+	bool ApplyPatch(Json&& patch);
 	static Json JObject(std::initializer_list<std::pair<const std::string, const Json>> args);
 	static Json JArray(std::initializer_list<const Json> args);
 	static size_t FindExt(const std::string& text, const std::string& delimiter);
 
-	void Save(const std::string& path);
-	Json Load(const std::string& path);
+	void Save(const std::string& path, const Format format = Format::Text) const;
+	//Saves the text of Stringify(options), writing its pieces out in order without joining them first
+	void Save(const std::string& path, const ParallelOptions& options) const;
+	static Json Load(const std::string& path, const LoadMode mode = LoadMode::Mapped, const Format format = Format::Text);
+	void WriteSnapshot(const std::string& path) const;
+	static SnapshotView MapSnapshot(const std::string& path);
 
 	void Print() const;
 	
 	Iterator begin() const;
 	Iterator end() const;
 
-	const std::string Stringify();
+	const std::string Stringify() const;
+	//Same text as Stringify, with the members of large containers split into ranges that are serialized on several threads
+	const std::string Stringify(const ParallelOptions& options) const;
 	static Json Parse(const std::string& js);
+	static Json Parse(std::string_view js);
+	static Json Parse(const char* js);
+	static Json Parse(const char* js, const size_t length);
+	//Parses the members of a top level array or object on several threads and moves them into one value. Anything else, or
+	//input too small to split into two runs, is parsed on the calling thread
+	static Json Parse(std::string_view js, const ParallelOptions& options);
+	static bool ParseEvents(std::string_view js, Handler& handler);
+	//Parse straight into a struct bound with JSON_FIELDS, or a string, number, vector or array of those, and the other way
+	//round, without building a tree. Defined in JsonBind.h
+	template<typename T>
+	static bool Read(std::string_view js, T& value);
+	template<typename T>
+	static T Read(std::string_view js);
+	template<typename T>
+	static std::string Write(const T& value, const bool bPretty = false);
+	const std::string ToMessagePack() const;
+	static Json FromMessagePack(std::string_view data);
 	static const bool Compare(const std::vector<Json>& a, const std::vector<Json>& b);
 	static const bool Compare(const std::map<std::string, Json>& a, const std::map<std::string, Json>& b);
+	static const bool Compare(const ArrayStorage& a, const ArrayStorage& b);
+	static const bool Compare(const ObjectStorage& a, const ObjectStorage& b);
 	
 private:
-	static void PrintS(std::string& text, size_t& offset, const Json& json);
-	static size_t FindFirstNotOf(const std::string& str, std::set<char> del, const bool bAsc);
+	template<typename Sink>
+	class Parser;
+	class DomBuilder;
+	class Unpacker;
+	class Arena;
+	struct SnapshotHeader;
+	struct SnapshotSlot;
+	class SnapshotBuilder;
+	struct SharedCount;
+	struct StringifyPiece;
+	std::vector<StringifyPiece> StringifyPieces(const ParallelOptions& options) const;
+	void PlanPieces(Writer& writer, std::string& literal, std::vector<StringifyPiece>& pieces, const size_t ranges, const size_t minSize) const;
+	size_t EstimateSize(const size_t limit) const;
+	const Json* Child(const Path& path, const size_t i) const;
+	Json& Member(std::string_view key);
+	Json* Resolve(const Path& path, const size_t count);
+	bool AddAt(const Path& path, Json&& value);
+	bool RemoveAt(const Path& path, Json* removed);
+	static void DiffInto(const Json& a, const Json& b, std::string& path, Json& patch);
+	static bool Identical(const Json& a, const Json& b);
+	static bool IsPointer(const Json& path);
+	static Json& AddOperation(Json& patch, const char* op, std::string_view path);
+	static void AppendToken(std::string& path, std::string_view key);
+	const Json& Member(std::string_view key) const;
+
+	//Open addressing table of interned keys. A document's pool owns its keys outright, a counted pool holds one reference
+	//to each of its keys and hands out another one from every Intern.
+	class KeyPool
+	{
+	public:
+		KeyPool(std::pmr::memory_resource* resource, const bool bCounted);
+		KeyPool(const KeyPool&) = delete;
+		KeyPool& operator=(const KeyPool&) = delete;
+		~KeyPool();
+
+		Key Intern(std::string_view key);
+		Key Intern(std::string_view key, const uint32_t hash);
+
+	private:
+		std::vector<const Key::Data*> slots;
+		size_t count{ 0 };
+		std::pmr::memory_resource* resource;
+		bool bCounted;
+	};
 	void EllipArray(Json& self) {};
 	template<typename ARG, typename ... R>
 	void EllipArray(Json& self, ARG arg, const R& ... rest);
+	//Tagged value two pointers wide (16 bytes on x64). Scalars and strings of up to ShortCapacity chars live inline, everything else behind one pointer
 	struct Var
 	{
-		Type type = Type::Null;
+		static constexpr uint8_t HeapString = 0xFF;
+		static constexpr uint8_t BorrowedString = 0xFE;
+		static constexpr uint8_t Shared = 0xFD;	//Heap string or container in a reference counted block
+		static constexpr size_t ShortCapacity = 2 * sizeof(void*) - 2;
+
+		uint8_t type = Type::Null;
+		uint8_t shortLength = 0;
+		uint32_t borrowedLength;
 		union
 		{
 			bool boolVal;
 			int intVal;
 			float floatVal;
-			std::string* stringVal;
-			std::vector <Json>* arrayVal;
-			std::map<std::string, Json>* objectVal;
+			int64_t int64Val;
+			double doubleVal;
+			std::pmr::string* stringVal;
+			const char* borrowedChars;
+			ArrayStorage* arrayVal;
+			ObjectStorage* objectVal;
 		};
-		~Var() noexcept
-		{
-			switch (type)
-			{
-			case Json::String:
-				delete stringVal;
-				break;
-			case Json::Array:
-				delete arrayVal;
-				break;
-			case Json::Object:
-				delete objectVal;
-				break;
-			default:
-				break;
-			}
-		}
-		Var(const Var&) = delete;
-		Var(Var&&) noexcept = delete;
-		Var& operator=(const Var&) = delete;
-		Var& operator=(Var&&) noexcept = delete;
-		Var() = default;
-
-		void Copy(const std::unique_ptr<Var>& src);
-		std::string RemoveWS(const std::string & text);
-		void ParseAsInt(const std::string& text);
-		void ParseAsFloat(const std::string& text);
-		void ParseAsObject(const std::string& text);
-		void ParseAsArray(const std::string& text);
-		std::string ParseKV(const std::string& text, size_t& offset, const char delimiter);
-
-	};
-	std::unique_ptr<Var> var_;	
+
+		void Emplace(const Type type, std::pmr::memory_resource* resource, const ObjectOrder order = DefaultObjectOrder, const bool bShared = false);
+		void SetString(std::string_view str, std::pmr::memory_resource* resource);
+		void SetBorrowed(std::string_view str);
+		void Copy(const Var& src, std::pmr::memory_resource* resource);
+		void Duplicate(const Var& src, std::pmr::memory_resource* resource, const bool bShared);
+		void Share();
+		void Detach();
+		bool IsShared() const;
+		SharedCount& Count() const;
+		uint64_t CachedHash() const;
+		bool HashDiffers(const Var& other) const;
+		void Release() noexcept;
+		std::string_view Str() const;
+		std::pmr::memory_resource* Resource() const;
+		bool IsNumber() const;
+		int64_t AsInt64() const;
+		int AsInt() const;
+		double AsDouble() const;
+		bool NumberEquals(const Var& other) const;
+		char* ShortChars() { return reinterpret_cast<char*>(this) + 2; }
+		const char* ShortChars() const { return reinterpret_cast<const char*>(this) + 2; }
+	};
+
+	static std::pmr::memory_resource* HeapResource();
+	static KeyPool* PoolOf(std::pmr::memory_resource* resource);
+	static Key ShareKey(const Key& key, KeyPool* pool);
+	static Json Make(const Type type, std::pmr::memory_resource* resource, const ObjectOrder order = DefaultObjectOrder);
+	static Json Clone(const Json& src, std::pmr::memory_resource* resource);
+	static Json& HandOut(Json& slot, std::pmr::memory_resource* resource);
+	std::pmr::memory_resource* SlotResource(const Json& value) const;
+	static bool ParseInto(Json& result, const char* js, const size_t length, std::pmr::memory_resource* resource, const ObjectOrder order = DefaultObjectOrder, const bool bBorrow = false);
+	static bool TryParseInto(Json& result, const char* js, const size_t length, std::pmr::memory_resource* resource, const ObjectOrder order = DefaultObjectOrder, const bool bBorrow = false);
+	static bool UnpackInto(Json& result, const char* data, const size_t length, std::pmr::memory_resource* resource, const ObjectOrder order = DefaultObjectOrder);
+	static void Pack(const Json& json, std::string& out);
+	template<typename T, typename ... Args>
+	static T* Create(std::pmr::memory_resource* resource, Args&& ... args);
+	template<typename T>
+	static void Destroy(T* ptr) noexcept;
+	template<typename T, typename ... Args>
+	static T* CreateShared(std::pmr::memory_resource* resource, Args&& ... args);
+	template<typename T>
+	static T* MakeShared(T* ptr);
+	template<typename T>
+	static void ReleaseShared(T* ptr) noexcept;
+
+	Var var_;
+};
+
+//Monotonic arena of a document together with the pool its object keys are interned in
+class Json::Arena final : public std::pmr::monotonic_buffer_resource
+{
+public:
+	explicit Arena(const size_t initialSize);
+	//Starts out in buffer and only goes to the heap once that is used up
+	Arena(void* buffer, const size_t size);
+	~Arena();
+
+	KeyPool keys;
 };
 
+//Owns a monotonic arena that every node, container and string of its tree is allocated from.
+//The arena is released in one go when the document is destroyed, so values moved out of it must not outlive it.
+//Copying a value into a null, number or short string of the tree (doc.Root()["a"] = value) copies it into the arena as long as
+//the slot is the one last handed out by a non-const accessor on this thread, otherwise onto the heap.
+class Json::Document
+{
+public:
+	Document(const size_t initialSize = 64 * 1024, const ObjectOrder order = DefaultObjectOrder);
+	Document(const Document&) = delete;
+	Document& operator=(const Document&) = delete;
+
+	Json& Parse(std::string_view js);
+	Json& Load(const std::string& path, const LoadMode mode = LoadMode::Mapped, const Format format = Format::Text);
+	//Like Parse and Load, but strings longer than the inline capacity point into the input instead of being copied, only the
+	//ones with escapes are decoded into the arena. Parsed text has to stay unchanged for as long as the document uses it,
+	//a loaded file stays mapped until the next load.
+	Json& ParseBorrowed(std::string_view js);
+	Json& LoadBorrowed(const std::string& path, const LoadMode mode = LoadMode::Mapped);
+	Json Create(const Type type = Type::Null);
+	Json& Root();
+	const Json& Root() const;
+
+private:
+	Arena arena;
+	ObjectOrder order;
+	Json root;
+	std::shared_ptr<const MappedFile> source;
+};
+
+//Read-only view of a document that is parsed on demand. A container is scanned for its members the first time one of them is
+//asked for, skipping over their contents, and a value is only built when it is read, so reading a few paths out of a big file
+//costs little more than one pass over the text leading up to them. Both are cached and shared by the views taken from a view,
+//so none of them are safe to read from several threads at once. A key or index that is not there gives an empty view, which
+//reads as null and can be indexed further. The text has to outlive the views, except for Load which keeps its file open for as
+//long as any of them lives.
+class Json::LazyView
+{
+public:
+	struct Iterator
+	{
+		Iterator* operator++();
+		bool operator!=(const Iterator& other) const;
+		Iterator& operator*();
+		std::string_view Key() const;
+		LazyView Value() const;
+	private:
+		friend class LazyView;
+		Iterator(const LazyView* view, const size_t index);
+		const LazyView* view;
+		size_t index;
+	};
+
+	LazyView();
+	explicit LazyView(std::string_view text);
+	static LazyView Load(const std::string& path, const LoadMode mode = LoadMode::Mapped);
+
+	LazyView operator[](std::string_view key) const;
+	LazyView operator[](const char* key) const;
+	LazyView operator[](size_t i) const;
+	LazyView operator[](int i) const;
+
+	operator bool() const;
+	operator int() const;
+	operator float() const;
+	operator int64_t() const;
+	operator double() const;
+	operator std::string() const;
+
+	const Type GetType() const;
+	const size_t Size() const;
+	bool Contains(std::string_view key) const;
+	std::string_view Text() const;
+	const Json& Value() const;
+
+	Iterator begin() const;
+	Iterator end() const;
+
+private:
+	struct Node;
+	struct Member;
+	explicit LazyView(std::shared_ptr<const Node> node);
+	LazyView At(const size_t i) const;
+	const Node* Find(std::string_view key) const;
+
+	std::shared_ptr<const Node> node;
+};
+
+//Read-only view into a snapshot written by WriteSnapshot. The snapshot is a flat tape of fixed size typed slots whose
+//containers point at their members by position, followed by an area holding each distinct string once. Nothing is decoded
+//up front, so mapping one takes the same time whatever its size and only the pages that are read get faulted in.
+//Members of insertion ordered objects keep their order, lookups binary search the keys either way.
+class Json::SnapshotView
+{
+public:
+	struct Iterator
+	{
+		Iterator* operator++();
+		bool operator!=(const Iterator& other) const;
+		Iterator& operator*();
+		std::string_view Key() const;
+		SnapshotView Value() const;
+	private:
+		friend class SnapshotView;
+		Iterator(const SnapshotView* view, const size_t index);
+		const SnapshotView* view;
+		size_t index;
+	};
+
+	SnapshotView();
+
+	SnapshotView operator[](std::string_view key) const;
+	SnapshotView operator[](const char* key) const;
+	SnapshotView operator[](size_t i) const;
+	SnapshotView operator[](int i) const;
+
+	operator bool() const;
+	operator int() const;
+	operator float() const;
+	operator int64_t() const;
+	operator double() const;
+	operator std::string() const;
+
+	const Type GetType() const;
+	const size_t Size() const;
+	bool Contains(std::string_view key) const;
+	std::string_view GetString() const;
+	//Copies this value and everything under it into a heap tree
+	Json Value() const;
+
+	Iterator begin() const;
+	Iterator end() const;
+
+private:
+	friend class Json;
+	SnapshotView(std::shared_ptr<const MappedFile> file, const SnapshotHeader* header, const SnapshotSlot* slot);
+	SnapshotView Child(const SnapshotSlot* child) const;
+	const SnapshotSlot* At(const uint64_t index) const;
+	const SnapshotSlot* MemberAt(const size_t i) const;
+	std::string_view KeyAt(const size_t i) const;
+	const SnapshotSlot* Find(std::string_view key) const;
+	std::string_view StringOf(const SnapshotSlot* string) const;
+	Var Scalar() const;
+
+	std::shared_ptr<const MappedFile> file;
+	const SnapshotHeader* header = nullptr;
+	const SnapshotSlot* slot = nullptr;
+};
+
+//Path into a tree, compiled once from an RFC 6901 pointer ("/Events/0/Name", with ~0 and ~1 escapes) or from a dotted path
+//("Events.0.Name"); an empty string is the root. Keys are hashed up front and a segment made of digits also indexes arrays.
+class Json::Path
+{
+public:
+	Path() = default;
+	Path(std::string_view path);
+	Path(const char* path);
+	Path(const std::string& path);
+
+	size_t Size() const;
+	std::string_view Key(const size_t i) const;
+
+private:
+	friend class Json;
+	struct Segment
+	{
+		uint32_t offset;
+		uint32_t length;
+		uint32_t hash;
+		size_t index;	//SIZE_MAX unless the key is an array index
+	};
+	void Append(std::string_view key);
+
+	std::string keys;
+	std::vector<Segment> segments;
+};
+
+//Batch of paths for FindAll, sorted once so that each path only has to resolve what it does not share with the one before it
+class Json::PathSet
+{
+public:
+	PathSet(std::vector<Path> paths);
+
+	size_t Size() const;
+	const Path& operator[](const size_t i) const;
+
+private:
+	friend class Json;
+	struct Step
+	{
+		uint32_t index;		//Position of the path in the set
+		uint32_t shared;	//Leading segments it has in common with the path resolved before it
+	};
+
+	std::vector<Path> paths;
+	std::vector<Step> steps;
+};
+
+//Reads JSON Lines (one value per line, blank lines skipped) from a file or descriptor in blocks of BlockSize. Records are parsed
+//into an arena that keeps starting over in the same block of memory, so a record is only valid until the next one is read.
+class Json::LineReader
+{
+public:
+	static constexpr size_t BlockSize = 1024 * 1024;
+
+	LineReader(const std::string& path, const ObjectOrder order = DefaultObjectOrder);
+	LineReader(const int fd, const ObjectOrder order = DefaultObjectOrder);
+	LineReader(const LineReader&) = delete;
+	LineReader& operator=(const LineReader&) = delete;
+	~LineReader() noexcept;
+
+	bool IsOpen() const;
+	//Parses the next record, false at the end of the input or at a malformed line. A malformed line leaves a null record
+	//and the reader on the line after it, so calling Next again skips it
+	bool Next();
+	const Json& Record() const;
+	//Line number of the current record, counting from 1
+	size_t Line() const;
+	//Whether the last Next stopped at a malformed line rather than the end of the input
+	bool IsMalformed() const;
+	//Reads the rest of the input in batches of up to batchSize lines that threads workers (zero for one per hardware thread)
+	//parse and hand to process together with the index of their first record. Batches can be processed out of order and
+	//at the same time, and their records are only valid until process returns. False if a line was malformed, which stops
+	//the reading with no more batches handed to process
+	bool ForEachBatch(const size_t batchSize, const unsigned threads, const std::function<void(const std::vector<Json>& records, const size_t first)>& process);
+
+private:
+	bool ReadLine(std::string_view& line);
+
+	int fd = -1;
+	bool bOwned = false;
+	bool bEnd = false;
+	bool bMalformed = false;
+	ObjectOrder order;
+	std::vector<char> buffer;
+	size_t begin{ 0 };
+	size_t end{ 0 };
+	size_t line{ 0 };
+	size_t used{ 0 };
+	std::vector<std::max_align_t> block;
+	std::optional<Arena> arena;
+	Json record;
+};
+
+//Appends records as JSON Lines, collecting them in a buffer that is written out whenever it passes ChunkSize, so every write
+//holds whole lines. A file is opened for appending
+class Json::LineWriter
+{
+public:
+	static constexpr size_t ChunkSize = 64 * 1024;
+
+	LineWriter(const std::string& path);
+	LineWriter(const int fd);
+	LineWriter(const LineWriter&) = delete;
+	LineWriter& operator=(const LineWriter&) = delete;
+	~LineWriter() noexcept;
+
+	bool IsOpen() const;
+	LineWriter& Write(const Json& record);
+	void Flush();
+
+private:
+	int fd = -1;
+	bool bOwned = false;
+	std::string buffer;
+	Writer writer;
+};
+
+//Parses a document handed over in pieces split anywhere, building its tree as they arrive, so that little is left to do once
+//the last one is in. Only a key, string or number cut in two by the end of a piece is copied aside until the rest of it comes.
+class Json::PushParser
+{
+public:
+	explicit PushParser(const ObjectOrder order = DefaultObjectOrder);
+	PushParser(const PushParser&) = delete;
+	PushParser& operator=(const PushParser&) = delete;
+	~PushParser();
+
+	//False once the text so far can not start a document, anything fed after that is ignored
+	bool Feed(const char* data, const size_t length);
+	bool Feed(std::string_view data);
+	//Ends the document and hands it over, null if it was malformed or incomplete. The parser then starts over for the next one
+	Json Finish();
+
+private:
+	enum class Expect : uint8_t { Value, ValueOrClose, Key, KeyOrClose, Colon, CommaOrClose, End };
+	enum class Token : uint8_t { None, String, Key, Scalar };
+
+	const char* ScanToken(const char* cur, const char* end, bool& bDone);
+	bool Emit(std::string_view text);
+	bool Close(const char close);
+	void Reset();
+
+	ObjectOrder order;
+	Json root;
+	std::unique_ptr<DomBuilder> builder;
+	std::vector<char> containers;
+	std::string pending;
+	Expect expect = Expect::Value;
+	Token token = Token::None;
+	bool bEscape = false;
+	bool bFailed = false;
+};
+
+//Pulls a document apart value by value in whatever shape the caller expects, for the typed binding in JsonBind.h.
+//Every step is false once the text does not have that shape
+class Json::Reader
+{
+public:
+	explicit Reader(std::string_view js);
+	Reader(const Reader&) = delete;
+	Reader& operator=(const Reader&) = delete;
+	~Reader();
+
+	bool Read(bool& val);
+	bool Read(int& val);
+	bool Read(int64_t& val);
+	bool Read(float& val);
+	bool Read(double& val);
+	bool Read(std::string& val);
+	bool StartObject();
+	//Key of the next member, or bMore cleared once the object closes
+	bool NextKey(std::string_view& key, bool& bMore);
+	bool StartArray();
+	//Moves on to the next element, or clears bMore once the array closes
+	bool NextElement(bool& bMore);
+	//Passes over a value only following its strings and nesting
+	bool Skip();
+	//Nothing but whitespace is left
+	bool Finish();
+
+private:
+	struct Source;
+	bool Next(const char close, bool& bMore);
+
+	std::unique_ptr<Source> source;
+	bool bFirst = false;
+};
+
+template<typename T, typename ... Args>
+inline T* Json::Create(std::pmr::memory_resource* resource, Args&& ... args)
+{
+	void* memory = resource->allocate(sizeof(T), alignof(T));
+	return new (memory) T(std::forward<Args>(args)..., typename T::allocator_type(resource));
+}
+
+template<typename T>
+inline void Json::Destroy(T* ptr) noexcept
+{
+	auto* resource = ptr->get_allocator().resource();
+	ptr->~T();
+	resource->deallocate(ptr, sizeof(T), alignof(T));
+}
+
 template<typename ARG, typename ...R>
 inline void Json::EllipArray(Json& self, ARG arg, const R & ...rest)
 {
@@ -162,9 +1008,16 @@ inline void Json::EllipArray(Json& self, ARG arg, const R & ...rest)
 
 template<typename ARG, typename ...R>
 inline Json::Json(ARG arg, const R & ...rest)
-	:var_(new Var)
 {
-	var_->type = Type::Array;
-	var_->arrayVal = new std::vector<Json>;
+	var_.Emplace(Type::Array, HeapResource());
 	EllipArray(*this, arg, rest...);
 };
+
+namespace std
+{
+	template<>
+	struct hash<Json>
+	{
+		size_t operator()(const Json& json) const { return (size_t)json.Hash(); }
+	};
+}
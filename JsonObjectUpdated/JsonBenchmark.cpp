@@ -0,0 +1,573 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <map>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <memory_resource>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#include "Json.h"
+#include "JsonBind.h"
+#include "JsonSnapshot.h"
+#include "LegacyJson.h"
+
+//Times the parser and the features built on it against a generated corpus of ship records, and the old parser where it can
+//read the same text. Usage: JsonBenchmark [records] [large file MB], where 0 MB skips the large files, which grow up to that
+//size. Each figure is the best of Runs runs, except the large file loads, which run once each in a process of their own so
+//that each gets its own peak resident memory
+
+namespace
+{
+	constexpr int Runs = 5;
+
+	//Every allocation starts with its size, so that the bytes in use can be told
+	constexpr size_t Header = alignof(std::max_align_t);
+	std::atomic<size_t> allocations{ 0 };
+	std::atomic<size_t> inUse{ 0 };
+
+	//Allocations made since it was created, and how many bytes of them are still in use
+	struct Counted
+	{
+		Counted() : calls(allocations.load()), bytes(inUse.load()) {}
+		size_t Calls() const { return allocations.load() - calls; }
+		size_t Bytes() const { return inUse.load() - bytes; }
+		size_t calls;
+		size_t bytes;
+	};
+
+	//Default resource that goes through the counted operator new, which the aligned one the library uses by default does not
+	struct Counting final : std::pmr::memory_resource
+	{
+		void* do_allocate(size_t bytes, size_t alignment) override
+		{
+			return alignment > Header ? ::operator new(bytes, std::align_val_t(alignment)) : ::operator new(bytes);
+		}
+		void do_deallocate(void* ptr, size_t, size_t alignment) override
+		{
+			if (alignment > Header)
+				::operator delete(ptr, std::align_val_t(alignment));
+			else
+				::operator delete(ptr);
+		}
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+	};
+
+	template<typename Work>
+	double Best(Work&& work)
+	{
+		double best = 1e30;
+		for (int i = 0; i < Runs; i++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			work();
+			best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		}
+		return best;
+	}
+
+	void Section(const char* title)
+	{
+		std::cout << std::endl << title << std::endl;
+	}
+
+	void Report(const char* name, const double seconds, const size_t bytes = 0, const size_t peakKilobytes = 0)
+	{
+		std::cout << "  " << std::left << std::setw(44) << name << std::right << std::fixed << std::setprecision(2) << std::setw(10) << seconds * 1000 << " ms";
+		if (bytes)
+			std::cout << std::setw(10) << bytes / seconds / (1024 * 1024) << " MB/s";
+		if (peakKilobytes)
+			std::cout << std::setw(10) << peakKilobytes / 1024 << " MB peak";
+		std::cout << std::endl;
+	}
+
+	//Most memory the process has had resident so far
+	size_t PeakKilobytes()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters{};
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return 0;
+		return counters.PeakWorkingSetSize / 1024;
+#else
+		rusage usage{};
+		if (getrusage(RUSAGE_SELF, &usage))
+			return 0;
+#ifdef __APPLE__
+		return usage.ru_maxrss / 1024;
+#else
+		return usage.ru_maxrss;
+#endif
+#endif
+	}
+
+	void Count(const char* name, const Counted& counted)
+	{
+		std::cout << "  " << std::left << std::setw(44) << name << std::right << std::setw(10) << counted.Calls() << " allocations" << std::setw(12) << counted.Bytes() / 1024 << " KB in use" << std::endl;
+	}
+
+	//Text the old parser reads as well: no 64 bit integers, no escapes, no exponents
+	std::string Records(const size_t count, const bool bWide)
+	{
+		std::string text = "[";
+		for (size_t i = 0; i < count; i++)
+		{
+			if (i)
+				text += ",";
+			text += "{\"Id\":" + std::to_string(i) + ",\"Name\":\"ship number " + std::to_string(i) + "\",\"Alive\":" + (i % 3 ? "true" : "false");
+			if (bWide)
+				text += ",\"Serial\":" + std::to_string(5000000000LL + (long long)i) + ",\"Score\":" + std::to_string(i * 0.1234567891234);
+			text += ",\"Shoot\":[3,4],\"ShipLocations\":[[6.5,5.25],[45.0,6.0],[1.5," + std::to_string(i % 100) + ".5]]";
+			text += ",\"Path\":[";
+			for (int j = 0; j < 16; j++)
+				text += (j ? "," : "") + std::to_string(j + (i % 7)) + ".25";
+			text += "]}";
+		}
+		return text + "]";
+	}
+
+	//Writes records the old parser reads, one to a line, until the file is at least megabytes long. Returns its size
+	size_t WriteLarge(const std::string& path, const size_t megabytes)
+	{
+		const std::string records = Records(1000, false);
+		const std::string chunk = records.substr(1, records.size() - 2);
+		std::ofstream file(path, std::ios::binary);
+		size_t size = 1;
+		file << "[";
+		for (bool bFirst = true; size < megabytes * 1024 * 1024; bFirst = false)
+		{
+			if (!bFirst)
+				file << ",\n";
+			file << chunk;
+			size += chunk.size() + (bFirst ? 0 : 2);
+		}
+		file << "]";
+		return size + 1;
+	}
+
+	//Runs in a process of its own: loads path one way and prints how long that took and the peak resident memory after it
+	int LoadOnce(const std::string& loader, const std::string& path)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		size_t loaded = 0;
+		if (loader == "old")
+			loaded = Legacy::Json().Load(path).Size();
+		else if (loader == "mapped")
+			loaded = Json::Load(path, Json::LoadMode::Mapped).Size();
+		else if (loader == "buffered")
+			loaded = Json::Load(path, Json::LoadMode::Buffered).Size();
+		else if (loader == "document")
+		{
+			Json::Document doc;
+			loaded = doc.Load(path).Size();
+		}
+		else if (loader != "nothing")
+			return 1;
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << seconds << " " << PeakKilobytes() << " " << loaded << std::endl;
+		return 0;
+	}
+
+	//Runs LoadOnce in a new process of this program and reports what it printed. Returns the seconds the load took
+	double LoadApart(const char* program, const char* name, const char* loader, const std::string& path, const size_t bytes)
+	{
+		std::string command = std::string("\"") + program + "\" --load " + loader + " \"" + path + "\"";
+#ifdef _WIN32
+		//cmd takes the outer quotes off a command that starts with one
+		command = "\"" + command + "\"";
+		FILE* output = _popen(command.c_str(), "r");
+#else
+		FILE* output = popen(command.c_str(), "r");
+#endif
+		double seconds = 0;
+		size_t peak = 0;
+		size_t loaded = 0;
+		const bool bRead = output && std::fscanf(output, "%lf %zu %zu", &seconds, &peak, &loaded) == 3;
+#ifdef _WIN32
+		const bool bExited = output && !_pclose(output);
+#else
+		const bool bExited = output && !pclose(output);
+#endif
+		if (bRead && bExited)
+			Report(name, seconds, bytes, peak);
+		else
+			std::cout << "  " << std::left << std::setw(44) << name << std::right << "    failed" << std::endl;
+		return seconds;
+	}
+
+	struct Ship
+	{
+		int Id;
+		std::string Name;
+		bool Alive;
+		std::vector<int> Shoot;
+		std::vector<std::vector<float>> ShipLocations;
+		std::vector<float> Path;
+	};
+	JSON_FIELDS(Ship, Id, Name, Alive, Shoot, ShipLocations, Path)
+}
+
+void* operator new(size_t size)
+{
+	auto block = static_cast<char*>(std::malloc(size + Header));
+	if (!block)
+		throw std::bad_alloc();
+	*reinterpret_cast<size_t*>(block) = size;
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	inUse.fetch_add(size, std::memory_order_relaxed);
+	return block + Header;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	if (!ptr)
+		return;
+	const auto block = static_cast<char*>(ptr) - Header;
+	inUse.fetch_sub(*reinterpret_cast<size_t*>(block), std::memory_order_relaxed);
+	std::free(block);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	operator delete(ptr);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc == 4 && std::string(argv[1]) == "--load")
+		return LoadOnce(argv[2], argv[3]);
+	Counting counting;
+	std::pmr::set_default_resource(&counting);
+	const size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 5000;
+	const size_t largeMegabytes = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100;
+	const unsigned threads = std::max(2u, std::thread::hardware_concurrency());
+	const std::string text = Records(count, false);
+	const std::string wide = Records(count, true);
+	std::cout << count << " records, " << text.size() / 1024 << " KB of text, " << threads << " threads" << std::endl;
+
+	Section("Parse");
+	Report("old Json::Parse", Best([&] { Legacy::Json::Parse(text); }), text.size());
+	Report("Json::Parse", Best([&] { Json::Parse(text); }), text.size());
+	Report("Document::Parse", Best([&] { Json::Document doc(text.size() * 2); doc.Parse(text); }), text.size());
+	Report("Document::ParseBorrowed", Best([&] { Json::Document doc(text.size()); doc.ParseBorrowed(text); }), text.size());
+	Report("Json::Parse, 64 bit and double numbers", Best([&] { Json::Parse(wide); }), wide.size());
+	{
+		Json::Document doc;
+		Counted legacy;
+		{ Legacy::Json tree = Legacy::Json::Parse(text); Count("old Json::Parse", legacy); }
+		Counted heap;
+		{ Json tree = Json::Parse(text); Count("Json::Parse", heap); }
+		Counted arena;
+		doc.Parse(text);
+		Count("Document::Parse", arena);
+	}
+	{
+		std::vector<Legacy::Json> legacy;
+		std::vector<Json> heap;
+		std::deque<Json::Document> docs;
+		for (int i = 0; i < Runs; i++)
+		{
+			legacy.push_back(Legacy::Json::Parse(text));
+			heap.push_back(Json::Parse(text));
+			docs.emplace_back(text.size() * 2);
+			docs.back().Parse(text);
+		}
+		Report("destroy old tree", Best([&] { legacy.pop_back(); }));
+		Report("destroy tree", Best([&] { heap.pop_back(); }));
+		Report("destroy document", Best([&] { docs.pop_back(); }));
+	}
+
+	Section("Read");
+	{
+		const Json tree = Json::Parse(wide);
+		double sum = 0;
+		Report("lookup Name and Score of every record", Best([&]
+		{
+			for (size_t i = 0; i < tree.Size(); i++)
+				sum += tree[i]["Name"].GetString().size() + (double)tree[i]["Score"];
+		}));
+		Report("sum every packed Path", Best([&]
+		{
+			for (const auto& record : tree)
+				for (const double val : record.Value()["Path"].Numbers<double>())
+					sum += val;
+		}));
+		Report("Hash", Best([&] { sum += tree.Hash() & 1; }));
+		const Json frozen = tree.Freeze();
+		const Json copy = frozen;
+		Report("compare two copies of a frozen tree", Best([&] { sum += frozen == copy; }));
+		const Json other = Json::Parse(wide);
+		Report("compare two separate trees", Best([&] { sum += tree == other; }));
+		Report("Stringify", Best([&] { sum += tree.Stringify().size(); }), wide.size());
+		std::cout << "  (checksum " << sum << ")" << std::endl;
+	}
+
+	Section("Objects");
+	{
+		//Each size runs the same number of entries in all, spread over as many objects as it takes
+		const size_t entries = count * 20;
+		double sum = 0;
+		for (const size_t keyCount : { size_t(8), size_t(64), size_t(1024) })
+		{
+			std::vector<std::string> keys;
+			for (size_t i = 0; i < keyCount; i++)
+				keys.push_back("key number " + std::to_string(i * 7919 % keyCount));
+			const size_t objects = std::max<size_t>(entries / keyCount, 1);
+			const std::string label = " " + std::to_string(keyCount) + " keys";
+			Report(("insert" + label + ", Json").c_str(), Best([&]
+			{
+				for (size_t o = 0; o < objects; o++)
+				{
+					Json obj(Json::Type::Object);
+					for (size_t i = 0; i < keyCount; i++)
+						obj.Set(keys[i], (int)i);
+					sum += obj.Size();
+				}
+			}));
+			Report(("insert" + label + ", std::map").c_str(), Best([&]
+			{
+				for (size_t o = 0; o < objects; o++)
+				{
+					std::map<std::string, Json> obj;
+					for (size_t i = 0; i < keyCount; i++)
+						obj[keys[i]] = (int)i;
+					sum += obj.size();
+				}
+			}));
+			Json filled(Json::Type::Object);
+			std::map<std::string, Json> mapped;
+			for (size_t i = 0; i < keyCount; i++)
+			{
+				filled.Set(keys[i], (int)i);
+				mapped[keys[i]] = (int)i;
+			}
+			const Json& obj = filled;
+			Report(("lookup" + label + ", Json").c_str(), Best([&]
+			{
+				for (size_t o = 0; o < objects; o++)
+					for (const auto& key : keys)
+						sum += (int)obj[key];
+			}));
+			Report(("lookup" + label + ", std::map").c_str(), Best([&]
+			{
+				for (size_t o = 0; o < objects; o++)
+					for (const auto& key : keys)
+						sum += (int)mapped.find(key)->second;
+			}));
+			Report(("iterate" + label + ", Json").c_str(), Best([&]
+			{
+				for (size_t o = 0; o < objects; o++)
+					for (const auto& entry : obj)
+						sum += (int)entry.Value();
+			}));
+			Report(("iterate" + label + ", std::map").c_str(), Best([&]
+			{
+				for (size_t o = 0; o < objects; o++)
+					for (const auto& entry : mapped)
+						sum += (int)entry.second;
+			}));
+		}
+		std::cout << "  (checksum " << sum << ")" << std::endl;
+	}
+
+	Section("Packed arrays");
+	{
+		std::string numbers = "[";
+		for (size_t i = 0; i < count * 50; i++)
+			numbers += (i ? "," : "") + std::to_string(i % 1000) + ".5";
+		const std::string mixed = numbers + ",null]";
+		numbers += "]";
+		Counted packedMemory;
+		const Json packed = Json::Parse(numbers);
+		Count("packed doubles", packedMemory);
+		Counted genericMemory;
+		const Json generic = Json::Parse(mixed);
+		Count("the same with a null at the end", genericMemory);
+		double sum = 0;
+		Report("Parse packed", Best([&] { Json::Parse(numbers); }), numbers.size());
+		Report("Parse unpacked", Best([&] { Json::Parse(mixed); }), mixed.size());
+		Report("sum through Numbers", Best([&] { for (const double val : packed.Numbers<double>()) sum += val; }));
+		Report("sum by iterating packed", Best([&] { for (const auto& val : packed) sum += (double)val.Value(); }));
+		Report("sum by iterating unpacked", Best([&] { for (const auto& val : generic) sum += (double)val.Value(); }));
+		Report("Stringify packed", Best([&] { sum += packed.Stringify().size(); }), numbers.size());
+		Report("Stringify unpacked", Best([&] { sum += generic.Stringify().size(); }), mixed.size());
+		std::cout << "  (checksum " << sum << ")" << std::endl;
+	}
+
+	Section("Parallel");
+	{
+		//Thread counts double from 1 and end on every thread, and each thread gets about four chunks
+		std::vector<unsigned> sweep;
+		for (unsigned t = 1; t < threads; t *= 2)
+			sweep.push_back(t);
+		sweep.push_back(threads);
+		const Json tree = Json::Parse(wide);
+		for (const unsigned t : sweep)
+		{
+			Json::ParallelOptions options;
+			options.threads = t;
+			options.chunkSize = std::max<size_t>(wide.size() / (t * 4), 64 * 1024);
+			const std::string label = " on " + std::to_string(t) + (t == 1 ? " thread" : " threads");
+			Report(("Parse" + label).c_str(), Best([&] { Json::Parse(wide, options); }), wide.size());
+			Report(("Stringify" + label).c_str(), Best([&] { tree.Stringify(options); }), wide.size());
+		}
+	}
+
+	Section("Files");
+	{
+		const std::string path = "JsonBenchmark.json";
+		const std::string packPath = "JsonBenchmark.msgpack";
+		const std::string linesPath = "JsonBenchmark.jsonl";
+		const Json tree = Json::Parse(wide);
+		Report("Save", Best([&] { tree.Save(path); }), wide.size());
+		Report("Load mapped", Best([&] { Json::Load(path, Json::LoadMode::Mapped); }), wide.size());
+		Report("Load buffered", Best([&] { Json::Load(path, Json::LoadMode::Buffered); }), wide.size());
+		Report("Document::Load", Best([&] { Json::Document doc(wide.size() * 2); doc.Load(path); }), wide.size());
+		Report("LazyView::Load, one record", Best([&] { (void)(int)Json::LazyView::Load(path)[count / 2]["Id"]; }), wide.size());
+		const std::string message = tree.ToMessagePack();
+		std::cout << "  MessagePack is " << message.size() * 100 / wide.size() << "% of the text" << std::endl;
+		Report("ToMessagePack", Best([&] { tree.ToMessagePack(); }), message.size());
+		Report("FromMessagePack", Best([&] { Json::FromMessagePack(message); }), message.size());
+		tree.Save(packPath, Json::Format::MessagePack);
+		Report("Load MessagePack", Best([&] { Json::Load(packPath, Json::LoadMode::Mapped, Json::Format::MessagePack); }), message.size());
+		{
+			std::remove(linesPath.c_str());
+			Json::LineWriter writer(linesPath);
+			for (const auto& record : tree)
+				writer.Write(record.Value());
+		}
+		Report("LineReader::Next", Best([&]
+		{
+			Json::LineReader reader(linesPath);
+			while (reader.Next())
+				;
+		}), wide.size());
+		Report("LineReader::ForEachBatch", Best([&]
+		{
+			Json::LineReader reader(linesPath);
+			reader.ForEachBatch(1024, threads, [](const std::vector<Json>&, const size_t) {});
+		}), wide.size());
+		std::remove(path.c_str());
+		std::remove(packPath.c_str());
+		std::remove(linesPath.c_str());
+	}
+
+	if (largeMegabytes)
+	{
+		//The old parser takes time with the square of the size, so it stops once it gets slow and only the rest go on to the full size
+		Section("Large files");
+		const std::string path = "JsonBenchmark.large.json";
+		const double oldLimit = 2;
+		double oldSeconds = 0;
+		LoadApart(argv[0], "nothing loaded", "nothing", path, 0);
+		for (size_t megabytes = 1;; megabytes = std::min(megabytes * 4, largeMegabytes))
+		{
+			const size_t size = WriteLarge(path, megabytes);
+			std::cout << "  " << size / (1024 * 1024) << " MB, one record to a line" << std::endl;
+			if (oldSeconds <= oldLimit)
+				oldSeconds = LoadApart(argv[0], "old Json::Load", "old", path, size);
+			else
+				std::cout << "  " << std::left << std::setw(44) << "old Json::Load" << std::right << "   skipped" << std::endl;
+			LoadApart(argv[0], "Json::Load mapped", "mapped", path, size);
+			LoadApart(argv[0], "Json::Load buffered", "buffered", path, size);
+			LoadApart(argv[0], "Document::Load", "document", path, size);
+			if (megabytes == largeMegabytes)
+				break;
+		}
+		std::remove(path.c_str());
+	}
+
+	Section("Binding");
+	{
+		std::vector<Ship> ships;
+		Report("Json::Read into structs", Best([&] { ships.clear(); Json::Read(text, ships); }), text.size());
+		Report("Parse and copy into structs", Best([&]
+		{
+			const Json tree = Json::Parse(text);
+			ships.clear();
+			for (const auto& record : tree)
+			{
+				const Json& val = record.Value();
+				Ship ship;
+				ship.Id = val["Id"];
+				ship.Name = (std::string)val["Name"];
+				ship.Alive = val["Alive"];
+				for (const auto& shot : val["Shoot"])
+					ship.Shoot.push_back(shot.Value());
+				for (const auto& location : val["ShipLocations"])
+					ship.ShipLocations.push_back({ location.Value()[0], location.Value()[1] });
+				for (const double step : val["Path"].Numbers<double>())
+					ship.Path.push_back((float)step);
+				ships.push_back(std::move(ship));
+			}
+		}), text.size());
+		Report("Json::Write from structs", Best([&] { Json::Write(ships); }), text.size());
+	}
+
+	Section("Snapshot");
+	{
+		//Readers share a fixed number of lookups of a record of the current version while a writer publishes a new one every 100us.
+		//Reader counts double from 1 and end on one fewer than the hardware threads, leaving one for the writer
+		const Json tree = Json::Parse(text).Freeze();
+		const size_t reads = 200000;
+		JsonSnapshot snapshot(tree);
+		std::mutex lock;
+		Json guarded = tree;
+		const auto race = [&](const unsigned readerCount, const std::function<int()>& read)
+		{
+			std::atomic<bool> bDone{ false };
+			std::thread writer([&]
+			{
+				while (!bDone)
+				{
+					snapshot.Publish(tree);
+					{
+						std::lock_guard<std::mutex> hold(lock);
+						guarded = tree;
+					}
+					std::this_thread::sleep_for(std::chrono::microseconds(100));
+				}
+			});
+			std::vector<std::thread> readers;
+			std::atomic<long long> sum{ 0 };
+			for (unsigned t = 0; t < readerCount; t++)
+				readers.emplace_back([&] { long long local = 0; for (size_t i = 0; i < reads / readerCount; i++) local += read(); sum += local; });
+			for (auto& reader : readers)
+				reader.join();
+			bDone = true;
+			writer.join();
+			return sum.load();
+		};
+		const auto id = [](const Json& json) { return (int)json[7]["Id"]; };
+		const unsigned mostReaders = std::max(threads - 1, 1u);
+		std::vector<unsigned> sweep;
+		for (unsigned t = 1; t < mostReaders; t *= 2)
+			sweep.push_back(t);
+		sweep.push_back(mostReaders);
+		for (const unsigned readerCount : sweep)
+		{
+			const std::string label = ", " + std::to_string(readerCount) + (readerCount == 1 ? " reader" : " readers");
+			Report(("JsonSnapshot::Read" + label).c_str(), Best([&] { race(readerCount, [&] { return id(*snapshot.Read()); }); }));
+			Report(("copy under a mutex" + label).c_str(), Best([&] { race(readerCount, [&] { Json copy; { std::lock_guard<std::mutex> hold(lock); copy = guarded; } return id(copy); }); }));
+		}
+	}
+	std::cout << std::endl << "Peak resident memory of this process " << PeakKilobytes() / 1024 << " MB" << std::endl;
+	return 0;
+}
@@ -0,0 +1,236 @@
+#pragma once
+#include "Json.h"
+#include <array>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+
+//Binds plain structs to objects so that Json::Read and Json::Write go straight between them and text, with no tree in
+//between. A struct is bound by naming its members, next to it in its own namespace:
+//	struct ShipLocation { float x; float y; };
+//	JSON_FIELDS(ShipLocation, x, y)
+//Keys are matched to members by comparisons unrolled at compile time. Keys that name no member are skipped, members whose
+//key is missing keep their value. bool, int, int64_t, float, double, std::string, bound structs and std::vector and
+//std::array of any of them nest freely, and JsonCodec can be specialized for anything else.
+
+template<typename Struct, typename Member>
+struct JsonField
+{
+	std::string_view name;
+	Member Struct::* member;
+};
+
+//MSVC hands __VA_ARGS__ on as one argument unless it is expanded once more
+#define JSON_EXPAND(x) x
+#define JSON_FIELD(Struct, member) JsonField<Struct, decltype(Struct::member)>{ #member, &Struct::member }
+#define JSON_FIELDS_1(Struct, a) JSON_FIELD(Struct, a)
+#define JSON_FIELDS_2(Struct, a, ...) JSON_FIELD(Struct, a), JSON_EXPAND(JSON_FIELDS_1(Struct, __VA_ARGS__))
+#define JSON_FIELDS_3(Struct, a, ...) JSON_FIELD(Struct, a), JSON_EXPAND(JSON_FIELDS_2(Struct, __VA_ARGS__))
+#define JSON_FIELDS_4(Struct, a, ...) JSON_FIELD(Struct, a), JSON_EXPAND(JSON_FIELDS_3(Struct, __VA_ARGS__))
+#define JSON_FIELDS_5(Struct, a, ...) JSON_FIELD(Struct, a), JSON_EXPAND(JSON_FIELDS_4(Struct, __VA_ARGS__))
+#define JSON_FIELDS_6(Struct, a, ...) JSON_FIELD(Struct, a), JSON_EXPAND(JSON_FIELDS_5(Struct, __VA_ARGS__))
+#define JSON_FIELDS_7(Struct, a, ...) JSON_FIELD(Struct, a), JSON_EXPAND(JSON_FIELDS_6(Struct, __VA_ARGS__))
+#define JSON_FIELDS_8(Struct, a, ...) JSON_FIELD(Struct, a), JSON_EXPAND(JSON_FIELDS_7(Struct, __VA_ARGS__))
+#define JSON_FIELDS_9(Struct, a, ...) JSON_FIELD(Struct, a), JSON_EXPAND(JSON_FIELDS_8(Struct, __VA_ARGS__))
+#define JSON_FIELDS_10(Struct, a, ...) JSON_FIELD(Struct, a), JSON_EXPAND(JSON_FIELDS_9(Struct, __VA_ARGS__))
+#define JSON_FIELDS_11(Struct, a, ...) JSON_FIELD(Struct, a), JSON_EXPAND(JSON_FIELDS_10(Struct, __VA_ARGS__))
+#define JSON_FIELDS_12(Struct, a, ...) JSON_FIELD(Struct, a), JSON_EXPAND(JSON_FIELDS_11(Struct, __VA_ARGS__))
+#define JSON_FIELDS_13(Struct, a, ...) JSON_FIELD(Struct, a), JSON_EXPAND(JSON_FIELDS_12(Struct, __VA_ARGS__))
+#define JSON_FIELDS_14(Struct, a, ...) JSON_FIELD(Struct, a), JSON_EXPAND(JSON_FIELDS_13(Struct, __VA_ARGS__))
+#define JSON_FIELDS_15(Struct, a, ...) JSON_FIELD(Struct, a), JSON_EXPAND(JSON_FIELDS_14(Struct, __VA_ARGS__))
+#define JSON_FIELDS_16(Struct, a, ...) JSON_FIELD(Struct, a), JSON_EXPAND(JSON_FIELDS_15(Struct, __VA_ARGS__))
+#define JSON_FIELDS_PICK(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, NAME, ...) NAME
+//Up to 16 members
+#define JSON_FIELDS(Struct, ...) \
+	inline constexpr auto JsonFieldsOf(const Struct*) \
+	{ \
+		return std::make_tuple(JSON_EXPAND(JSON_EXPAND(JSON_FIELDS_PICK(__VA_ARGS__, JSON_FIELDS_16, JSON_FIELDS_15, JSON_FIELDS_14, \
+			JSON_FIELDS_13, JSON_FIELDS_12, JSON_FIELDS_11, JSON_FIELDS_10, JSON_FIELDS_9, JSON_FIELDS_8, JSON_FIELDS_7, JSON_FIELDS_6, \
+			JSON_FIELDS_5, JSON_FIELDS_4, JSON_FIELDS_3, JSON_FIELDS_2, JSON_FIELDS_1))(Struct, __VA_ARGS__))); \
+	}
+
+//Reads a T from a Json::Reader and writes one to a Json::Writer
+template<typename T, typename = void>
+struct JsonCodec;
+
+template<>
+struct JsonCodec<bool>
+{
+	static bool Read(Json::Reader& reader, bool& value) { return reader.Read(value); }
+	static void Write(Json::Writer& writer, const bool value) { writer.Bool(value); }
+};
+
+template<>
+struct JsonCodec<int>
+{
+	static bool Read(Json::Reader& reader, int& value) { return reader.Read(value); }
+	static void Write(Json::Writer& writer, const int value) { writer.Int(value); }
+};
+
+template<>
+struct JsonCodec<int64_t>
+{
+	static bool Read(Json::Reader& reader, int64_t& value) { return reader.Read(value); }
+	static void Write(Json::Writer& writer, const int64_t value) { writer.Int64(value); }
+};
+
+template<>
+struct JsonCodec<float>
+{
+	static bool Read(Json::Reader& reader, float& value) { return reader.Read(value); }
+	static void Write(Json::Writer& writer, const float value) { writer.Float(value); }
+};
+
+template<>
+struct JsonCodec<double>
+{
+	static bool Read(Json::Reader& reader, double& value) { return reader.Read(value); }
+	static void Write(Json::Writer& writer, const double value) { writer.Double(value); }
+};
+
+template<>
+struct JsonCodec<std::string>
+{
+	static bool Read(Json::Reader& reader, std::string& value) { return reader.Read(value); }
+	static void Write(Json::Writer& writer, const std::string& value) { writer.String(value); }
+};
+
+template<typename T>
+struct JsonCodec<std::vector<T>>
+{
+	static bool Read(Json::Reader& reader, std::vector<T>& value)
+	{
+		value.clear();
+		if (!reader.StartArray())
+			return false;
+		bool bMore = true;
+		while (reader.NextElement(bMore))
+		{
+			if (!bMore)
+				return true;
+			value.emplace_back();
+			if (!JsonCodec<T>::Read(reader, value.back()))
+				return false;
+		}
+		return false;
+	}
+
+	static void Write(Json::Writer& writer, const std::vector<T>& value)
+	{
+		writer.StartArray();
+		for (const auto& element : value)
+			JsonCodec<T>::Write(writer, element);
+		writer.EndArray();
+	}
+};
+
+//Takes exactly N elements
+template<typename T, size_t N>
+struct JsonCodec<std::array<T, N>>
+{
+	static bool Read(Json::Reader& reader, std::array<T, N>& value)
+	{
+		if (!reader.StartArray())
+			return false;
+		bool bMore = true;
+		for (auto& element : value)
+			if (!reader.NextElement(bMore) || !bMore || !JsonCodec<T>::Read(reader, element))
+				return false;
+		return reader.NextElement(bMore) && !bMore;
+	}
+
+	static void Write(Json::Writer& writer, const std::array<T, N>& value)
+	{
+		writer.StartArray();
+		for (const auto& element : value)
+			JsonCodec<T>::Write(writer, element);
+		writer.EndArray();
+	}
+};
+
+//Structs bound with JSON_FIELDS, found through their namespace
+template<typename T>
+struct JsonCodec<T, std::void_t<decltype(JsonFieldsOf(static_cast<const T*>(nullptr)))>>
+{
+	static constexpr auto fields = JsonFieldsOf(static_cast<const T*>(nullptr));
+	static constexpr size_t Count = std::tuple_size<decltype(fields)>::value;
+
+	static bool Read(Json::Reader& reader, T& value)
+	{
+		if (!reader.StartObject())
+			return false;
+		bool bMore = true;
+		std::string_view key;
+		while (reader.NextKey(key, bMore))
+		{
+			if (!bMore)
+				return true;
+			if (!ReadMember(reader, key, value, std::make_index_sequence<Count>()))
+				return false;
+		}
+		return false;
+	}
+
+	static void Write(Json::Writer& writer, const T& value)
+	{
+		writer.StartObject();
+		WriteMembers(writer, value, std::make_index_sequence<Count>());
+		writer.EndObject();
+	}
+
+private:
+	//The first member named key takes the value
+	template<size_t ... I>
+	static bool ReadMember(Json::Reader& reader, std::string_view key, T& value, std::index_sequence<I...>)
+	{
+		bool bRead = false;
+		const bool bBound = ((key == std::get<I>(fields).name && (bRead = ReadField<I>(reader, value), true)) || ...);
+		return bBound ? bRead : reader.Skip();
+	}
+
+	template<size_t I>
+	static bool ReadField(Json::Reader& reader, T& value)
+	{
+		auto& member = value.*std::get<I>(fields).member;
+		return JsonCodec<std::remove_reference_t<decltype(member)>>::Read(reader, member);
+	}
+
+	template<size_t ... I>
+	static void WriteMembers(Json::Writer& writer, const T& value, std::index_sequence<I...>)
+	{
+		((writer.Key(std::get<I>(fields).name), WriteField<I>(writer, value)), ...);
+	}
+
+	template<size_t I>
+	static void WriteField(Json::Writer& writer, const T& value)
+	{
+		const auto& member = value.*std::get<I>(fields).member;
+		JsonCodec<std::remove_cv_t<std::remove_reference_t<decltype(member)>>>::Write(writer, member);
+	}
+};
+
+template<typename T>
+bool Json::Read(std::string_view js, T& value)
+{
+	Reader reader(js);
+	return JsonCodec<T>::Read(reader, value) && reader.Finish();
+}
+
+//Value initialized if the text does not match T
+template<typename T>
+T Json::Read(std::string_view js)
+{
+	T value{};
+	if (!Read(js, value))
+		return T{};
+	return value;
+}
+
+template<typename T>
+std::string Json::Write(const T& value, const bool bPretty)
+{
+	std::string text;
+	Writer writer(text, bPretty);
+	JsonCodec<T>::Write(writer, value);
+	return text;
+}
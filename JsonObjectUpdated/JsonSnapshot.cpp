@@ -0,0 +1,94 @@
+#include "JsonSnapshot.h"
+#include <algorithm>
+#include <thread>
+
+JsonSnapshot::Reader::Reader(std::atomic<const Json*>* slot, const Json* json)
+	:slot(slot), json(json)
+{
+}
+
+JsonSnapshot::Reader::Reader(Reader&& other) noexcept
+	:slot(other.slot), json(other.json)
+{
+	other.slot = nullptr;
+}
+
+JsonSnapshot::Reader::~Reader() noexcept
+{
+	if (slot)
+		slot->store(nullptr, std::memory_order_release);
+}
+
+const Json& JsonSnapshot::Reader::operator*() const
+{
+	return *json;
+}
+
+const Json* JsonSnapshot::Reader::operator->() const
+{
+	return json;
+}
+
+JsonSnapshot::JsonSnapshot(const Json& initial)
+	:current(new Json(initial.Freeze()))
+{
+}
+
+JsonSnapshot::~JsonSnapshot()
+{
+	delete current.load();
+	for (const auto version : retired)
+		delete version;
+}
+
+//A thread starts looking for a free slot where it last found one. Pinning a version is only safe once current is seen to still
+//hold it afterwards: a publisher that swapped it out before then looks at the slots after the swap and finds the pin
+JsonSnapshot::Reader JsonSnapshot::Read() const
+{
+	thread_local size_t hint = std::hash<std::thread::id>()(std::this_thread::get_id());
+	for (size_t tried = 0; ; tried++)
+	{
+		if (tried > 0 && tried % SlotCount == 0)
+			std::this_thread::yield();
+		auto& pinned = slots[(hint + tried) % SlotCount].pinned;
+		const Json* free = nullptr;
+		auto version = current.load();
+		if (pinned.load(std::memory_order_relaxed) || !pinned.compare_exchange_strong(free, version))
+			continue;
+		for (auto now = current.load(); now != version; now = current.load())
+		{
+			version = now;
+			pinned.store(version);
+		}
+		hint = (hint + tried) % SlotCount;
+		return Reader(&pinned, version);
+	}
+}
+
+Json JsonSnapshot::Load() const
+{
+	return *Read();
+}
+
+void JsonSnapshot::Publish(const Json& json)
+{
+	const auto next = new Json(json.Freeze());
+	std::lock_guard<std::mutex> lock(publishing);
+	retired.push_back(current.exchange(next));
+	Reclaim();
+}
+
+void JsonSnapshot::Reclaim()
+{
+	std::array<const Json*, SlotCount> pins;
+	for (size_t i = 0; i < SlotCount; i++)
+		pins[i] = slots[i].pinned.load();
+	const auto end = std::remove_if(retired.begin(), retired.end(), [&pins](const Json* version)
+	{
+		if (std::find(pins.begin(), pins.end(), version) != pins.end())
+			return false;
+		delete version;
+		return true;
+	});
+	retired.erase(end, retired.end());
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "Json.h"
+#include <array>
+#include <mutex>
+
+//Current version of a document shared by threads that read it while others publish new ones. Published versions are frozen,
+//and a reader pins the one it starts on in a slot of its own for as long as it reads, so it never waits on a publisher or
+//copies anything. A replaced version is freed by the first Publish that finds no slot holding it any more.
+//Readers only wait when more than SlotCount of them are reading at the same moment.
+class JsonSnapshot
+{
+public:
+	static constexpr size_t SlotCount = 64;
+
+	class Reader
+	{
+	public:
+		Reader(Reader&& other) noexcept;
+		Reader(const Reader&) = delete;
+		Reader& operator=(const Reader&) = delete;
+		Reader& operator=(Reader&&) = delete;
+		~Reader() noexcept;
+
+		const Json& operator*() const;
+		const Json* operator->() const;
+
+	private:
+		friend class JsonSnapshot;
+		Reader(std::atomic<const Json*>* slot, const Json* json);
+
+		std::atomic<const Json*>* slot;
+		const Json* json;
+	};
+
+	explicit JsonSnapshot(const Json& initial = Json());
+	JsonSnapshot(const JsonSnapshot&) = delete;
+	JsonSnapshot& operator=(const JsonSnapshot&) = delete;
+	//No reader may outlive the snapshot
+	~JsonSnapshot();
+
+	//Pins the current version until the reader is gone
+	Reader Read() const;
+	//Copy of the current version that keeps it alive on its own, which only costs a reference as versions are frozen
+	Json Load() const;
+	//Freezes json into the next version. Publishers take turns, readers go on with the version they pinned
+	void Publish(const Json& json);
+
+private:
+	//Each slot on a cache line of its own, so readers on different slots do not slow each other down
+	struct alignas(64) Slot
+	{
+		std::atomic<const Json*> pinned{ nullptr };
+	};
+	void Reclaim();
+
+	std::atomic<const Json*> current;
+	mutable std::array<Slot, SlotCount> slots;
+	std::mutex publishing;
+	std::vector<const Json*> retired;
+};
@@ -0,0 +1,125 @@
+#include <iostream>
+#include <cstdint>
+#include <climits>
+#include <limits>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <utility>
+#include "Json.h"
+
+//Checks behaviour that has regressed before. Usage: JsonTests, which prints each failed check and returns how many failed.
+//Checks do not go through assert so that they still run in release builds
+
+namespace
+{
+	int failures = 0;
+
+	void Check(const bool bPassed, const char* what)
+	{
+		if (bPassed)
+			return;
+		failures++;
+		std::cout << "FAILED: " << what << std::endl;
+	}
+
+	//Converting a real to an integer saturates instead of overflowing, and NaN reads as 0
+	void IntegerConversions()
+	{
+		Check((int)Json::Parse("1e300") == INT_MAX, "(int)1e300 saturates");
+		Check((int)Json::Parse("-1e300") == INT_MIN, "(int)-1e300 saturates");
+		Check((int64_t)Json::Parse("1e300") == INT64_MAX, "(int64_t)1e300 saturates");
+		Check((int64_t)Json::Parse("-1e300") == INT64_MIN, "(int64_t)-1e300 saturates");
+		Check((int64_t)Json::Parse("9223372036854775808.0") == INT64_MAX, "(int64_t)2^63 saturates");
+		Check((int)Json::Parse("3000000000") == INT_MAX, "(int) of a large Int64 saturates");
+		Check((int)Json::Parse("-2.9") == -2, "(int)-2.9 truncates");
+		Check((int)Json(1e10f) == INT_MAX, "(int) of a large float saturates");
+		Check((int)Json(std::numeric_limits<double>::quiet_NaN()) == 0, "(int)NaN is 0");
+		Check((int64_t)Json(std::numeric_limits<float>::quiet_NaN()) == 0, "(int64_t)NaN is 0");
+		Check(Json(std::numeric_limits<double>::quiet_NaN()).Hash() == Json(std::numeric_limits<double>::quiet_NaN()).Hash(), "NaN hashes");
+	}
+
+	//Indexing a snapshot view through a missing key, a missing index or a value of the wrong type gives empty views
+	void SnapshotChaining()
+	{
+		const std::string path = "JsonTests.snapshot";
+		Json::Parse("{\"a\":{\"b\":[1,2,3]},\"n\":5}").WriteSnapshot(path);
+		{
+			const auto s = Json::MapSnapshot(path);
+			Check((int)s["a"]["b"][1] == 2, "snapshot reads a nested element");
+			Check(s["nope"]["x"].GetType() == Json::Type::Null, "snapshot chains through a missing key");
+			Check(s["nope"][0]["x"].GetType() == Json::Type::Null, "snapshot chains through a missing index");
+			Check(s["a"]["b"][7].GetType() == Json::Type::Null, "snapshot index past the end is null");
+			Check(s["n"]["x"][2].GetType() == Json::Type::Null, "snapshot indexes into a number");
+			Check(s["a"][0].GetType() == Json::Type::Null, "snapshot indexes an object by position");
+			Check(s[0]["a"].Size() == 0, "snapshot missing view has no members");
+		}
+		std::remove(path.c_str());
+	}
+
+	//Array of count ints, 0 to count - 1, which parsing packs
+	std::string Ints(const int count)
+	{
+		std::string text = "[";
+		for (int i = 0; i < count; i++)
+			text += (i ? "," : "") + std::to_string(i);
+		return text + "]";
+	}
+
+	//References and pointers to elements of a packed array stay good however many other elements are read after them
+	void PackedElementAddresses()
+	{
+		const Json j = Json::Parse("{\"a\":" + Ints(200) + "}");
+		Check(j["a"].Numbers<int>().size == 200, "200 ints are packed");
+		const Json& first = j["a"][0];
+		for (int i = 0; i < 200; i++)
+			(void)(int)j["a"][i];
+		Check((int)first == 0, "reference to element 0 outlives 200 more reads");
+		Check(&j["a"][5] == &j["a"][5], "an element keeps its address");
+
+		std::vector<Json::Path> paths;
+		for (int i = 0; i < 200; i++)
+			paths.emplace_back("/a/" + std::to_string(i));
+		const auto found = j.FindAll(Json::PathSet(std::move(paths)));
+		int wrong = 0;
+		for (int i = 0; i < 200; i++)
+			wrong += !found[i] || (int)*found[i] != i;
+		Check(wrong == 0, "FindAll into a packed array gives every element");
+		Check(j["a"].Numbers<int>().size == 200, "const reads leave the array packed");
+	}
+
+	//Reading elements through non-const references leaves an array packed, and numbers written through them go back into it
+	void PackedNonConstAccess()
+	{
+		Json j = Json::Parse("{\"a\":" + Ints(100) + "}");
+		int sum = 0;
+		for (int i = 0; i < 100; i++)
+			sum += (int)j["a"][i];
+		for (const auto& element : j["a"])
+			sum += (int)element.Value();
+		Check(sum == 9900, "non-const reads see the numbers");
+		Check(std::as_const(j)["a"].Numbers<int>().size == 100, "non-const reads leave the array packed");
+		Check(j.Find(Json::Path("/a/7")) && (int)*j.Find(Json::Path("/a/7")) == 7, "non-const Find reads a packed element");
+		Check(std::as_const(j)["a"].Numbers<int>().size == 100, "non-const Find leaves the array packed");
+
+		Json& third = j["a"][3];
+		third = 33;
+		Check((int)std::as_const(j)["a"][3] == 33 && j["a"].Stringify().find(",33,") != std::string::npos, "a write through a reference reads back");
+		j["a"].Add(100);
+		Check(j["a"].Numbers<int>().size == 101 && j["a"].Numbers<int>()[3] == 33, "a number written through a reference stays packed");
+
+		j["a"][5] = "five";
+		j["a"].Add(101);
+		Check(j["a"].Numbers<int>().size == 0 && (std::string)j["a"][5] == "five" && (int)j["a"][101] == 101, "a string written through a reference unpacks");
+	}
+}
+
+int main()
+{
+	IntegerConversions();
+	SnapshotChaining();
+	PackedElementAddresses();
+	PackedNonConstAccess();
+	std::cout << (failures ? "Some checks failed" : "All checks passed") << std::endl;
+	return failures;
+}
@@ -0,0 +1,133 @@
+#include "MappedFile.h"
+#include <fstream>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path, const bool bMap)
+{
+	bOpen = (bMap && Map(path)) || Read(path);
+}
+
+MappedFile::~MappedFile() noexcept
+{
+	Unmap();
+}
+
+bool MappedFile::IsOpen() const
+{
+	return bOpen;
+}
+
+bool MappedFile::IsMapped() const
+{
+	return bMapped;
+}
+
+const char* MappedFile::Data() const
+{
+	return data;
+}
+
+size_t MappedFile::Size() const
+{
+	return size;
+}
+
+std::string_view MappedFile::View() const
+{
+	return std::string_view(data, size);
+}
+
+#ifdef _WIN32
+bool MappedFile::Map(const std::string& path)
+{
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0 || (unsigned long long)fileSize.QuadPart > SIZE_MAX)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping)
+		return false;
+	const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		CloseHandle(mapping);
+		mapping = nullptr;
+		return false;
+	}
+	data = (const char*)view;
+	size = (size_t)fileSize.QuadPart;
+	bMapped = true;
+	return true;
+}
+
+void MappedFile::Unmap() noexcept
+{
+	if (!bMapped)
+		return;
+	UnmapViewOfFile(data);
+	CloseHandle(mapping);
+	bMapped = false;
+}
+#else
+bool MappedFile::Map(const std::string& path)
+{
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+	void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED)
+		return false;
+	(void)madvise(view, (size_t)info.st_size, MADV_SEQUENTIAL);
+	data = (const char*)view;
+	size = (size_t)info.st_size;
+	bMapped = true;
+	return true;
+}
+
+void MappedFile::Unmap() noexcept
+{
+	if (!bMapped)
+		return;
+	munmap((void*)data, size);
+	bMapped = false;
+}
+#endif
+
+bool MappedFile::Read(const std::string& path)
+{
+	std::ifstream is(path, std::ios::binary | std::ios::ate);
+	if (!is.is_open())
+		return false;
+	const auto length = is.tellg();
+	if (length < 0)
+		return false;
+	buffer.resize((size_t)length);
+	is.seekg(0);
+	if (!is.read(&buffer[0], length))
+		return false;
+	data = buffer.data();
+	size = buffer.size();
+	return true;
+}
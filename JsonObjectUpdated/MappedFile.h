@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+//Read-only view of a whole file. Memory mapped when possible, otherwise read into memory in one go
+class MappedFile
+{
+public:
+	MappedFile(const std::string& path, const bool bMap = true);
+	~MappedFile() noexcept;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile(MappedFile&&) noexcept = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile& operator=(MappedFile&&) noexcept = delete;
+
+	bool IsOpen() const;
+	bool IsMapped() const;
+	const char* Data() const;
+	size_t Size() const;
+	std::string_view View() const;
+
+private:
+	bool Map(const std::string& path);
+	bool Read(const std::string& path);
+	void Unmap() noexcept;
+
+	const char* data = nullptr;
+	size_t size = 0;
+	bool bOpen = false;
+	bool bMapped = false;
+	std::string buffer;
+#ifdef _WIN32
+	void* mapping = nullptr;
+#endif
+};
@@ -0,0 +1,438 @@
+#include "StructuralIndex.h"
+#include <algorithm>
+#include <cstring>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define STRUCTURAL_INDEX_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace
+{
+	StructuralIndex::Level Detect()
+	{
+#if defined(STRUCTURAL_INDEX_X86) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] >= 7)
+		{
+			__cpuid(info, 1);
+			const bool bOsSavesAvx = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+			__cpuidex(info, 7, 0);
+			if (bOsSavesAvx && (info[1] & (1 << 5)))
+				return StructuralIndex::Level::Avx2;
+		}
+		return StructuralIndex::Level::Sse2;
+#elif defined(STRUCTURAL_INDEX_X86)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return StructuralIndex::Level::Avx2;
+		return StructuralIndex::Level::Sse2;
+#else
+		return StructuralIndex::Level::Scalar;
+#endif
+	}
+
+	StructuralIndex::Level& Selected()
+	{
+		static StructuralIndex::Level level = Detect();
+		return level;
+	}
+
+	int TrailingZeros(const uint64_t bits)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, bits);
+		return (int)index;
+#else
+		return __builtin_ctzll(bits);
+#endif
+	}
+
+	//Without the popcnt instruction, which SSE2 machines may lack, the builtin ends up a library call
+	int PopCount(uint64_t bits)
+	{
+		bits -= (bits >> 1) & 0x5555555555555555ULL;
+		bits = (bits & 0x3333333333333333ULL) + ((bits >> 2) & 0x3333333333333333ULL);
+		bits = (bits + (bits >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+		return (int)((bits * 0x0101010101010101ULL) >> 56);
+	}
+
+	bool AddOverflow(const uint64_t a, const uint64_t b, uint64_t& result)
+	{
+		result = a + b;
+		return result < a;
+	}
+
+	//Each classifier hands emit the quote, backslash and whitespace bits of every whole 64 byte block in [cur, stop)
+	template<typename Emit>
+	void ClassifyScalar(const char* cur, const char* stop, Emit&& emit)
+	{
+		for (; stop - cur >= 64; cur += 64)
+		{
+			uint64_t quote{ 0 }, backslash{ 0 }, space{ 0 };
+			for (int i = 0; i < 64; i++)
+			{
+				const uint64_t bit = 1ULL << i;
+				switch (cur[i])
+				{
+				case '"':	quote |= bit; break;
+				case '\\':	backslash |= bit; break;
+				case ' ': case '\t': case '\n': case '\r':	space |= bit; break;
+				default:	break;
+				}
+			}
+			emit(quote, backslash, space);
+		}
+	}
+
+	//Splitting classifies quotes, backslashes, opening and closing brackets and commas instead, and stops once emit returns false
+	template<typename Emit>
+	void SplitScalar(const char* cur, const char* stop, Emit&& emit)
+	{
+		for (; stop - cur >= 64; cur += 64)
+		{
+			uint64_t quote{ 0 }, backslash{ 0 }, open{ 0 }, close{ 0 }, comma{ 0 };
+			for (int i = 0; i < 64; i++)
+			{
+				const uint64_t bit = 1ULL << i;
+				switch (cur[i])
+				{
+				case '"':	quote |= bit; break;
+				case '\\':	backslash |= bit; break;
+				case '{': case '[':	open |= bit; break;
+				case '}': case ']':	close |= bit; break;
+				case ',':	comma |= bit; break;
+				default:	break;
+				}
+			}
+			if (!emit(cur, quote, backslash, open, close, comma))
+				return;
+		}
+	}
+
+#ifdef STRUCTURAL_INDEX_X86
+	template<typename Emit>
+	void ClassifySse2(const char* cur, const char* stop, Emit&& emit)
+	{
+		for (; stop - cur >= 64; cur += 64)
+		{
+			uint64_t quote{ 0 }, backslash{ 0 }, space{ 0 };
+			for (int i = 0; i < 4; i++)
+			{
+				const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + 16 * i));
+				const __m128i spaces = _mm_or_si128(
+					_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+					_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'))));
+				const int shift = 16 * i;
+				quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"'))) << shift;
+				backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'))) << shift;
+				space |= (uint64_t)(uint16_t)_mm_movemask_epi8(spaces) << shift;
+			}
+			emit(quote, backslash, space);
+		}
+	}
+
+	template<typename Emit>
+	TARGET_AVX2 void ClassifyAvx2(const char* cur, const char* stop, Emit&& emit)
+	{
+		for (; stop - cur >= 64; cur += 64)
+		{
+			uint64_t quote{ 0 }, backslash{ 0 }, space{ 0 };
+			for (int i = 0; i < 2; i++)
+			{
+				const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur + 32 * i));
+				const __m256i spaces = _mm256_or_si256(
+					_mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t'))),
+					_mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r'))));
+				const int shift = 32 * i;
+				quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"'))) << shift;
+				backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\'))) << shift;
+				space |= (uint64_t)(uint32_t)_mm256_movemask_epi8(spaces) << shift;
+			}
+			emit(quote, backslash, space);
+		}
+	}
+
+	//'[' and ']' differ from '{' and '}' only in bit 0x20
+	template<typename Emit>
+	void SplitSse2(const char* cur, const char* stop, Emit&& emit)
+	{
+		for (; stop - cur >= 64; cur += 64)
+		{
+			uint64_t quote{ 0 }, backslash{ 0 }, open{ 0 }, close{ 0 }, comma{ 0 };
+			for (int i = 0; i < 4; i++)
+			{
+				const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + 16 * i));
+				const __m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+				const int shift = 16 * i;
+				quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"'))) << shift;
+				backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'))) << shift;
+				open |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{'))) << shift;
+				close |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))) << shift;
+				comma |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(','))) << shift;
+			}
+			if (!emit(cur, quote, backslash, open, close, comma))
+				return;
+		}
+	}
+
+	template<typename Emit>
+	TARGET_AVX2 void SplitAvx2(const char* cur, const char* stop, Emit&& emit)
+	{
+		for (; stop - cur >= 64; cur += 64)
+		{
+			uint64_t quote{ 0 }, backslash{ 0 }, open{ 0 }, close{ 0 }, comma{ 0 };
+			for (int i = 0; i < 2; i++)
+			{
+				const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur + 32 * i));
+				const __m256i folded = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+				const int shift = 32 * i;
+				quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"'))) << shift;
+				backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\'))) << shift;
+				open |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{'))) << shift;
+				close |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))) << shift;
+				comma |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(','))) << shift;
+			}
+			if (!emit(cur, quote, backslash, open, close, comma))
+				return;
+		}
+	}
+#endif
+}
+
+StructuralIndex::StructuralIndex(const char* begin, const char* end)
+	:cur(begin), end(end), base(begin)
+{
+}
+
+const char* StructuralIndex::Next(const char* pos, const bool bInString)
+{
+	while (true)
+	{
+		for (; current != count; current++)
+		{
+			const char* at = base + positions[current];
+			if (at >= pos)
+				return at;
+		}
+		if (cur < pos)
+		{
+			//Nothing between the indexed part and pos is needed, start over at pos with the parser's view of it
+			cur = pos;
+			prevOddBackslash = 0;
+			prevInString = bInString ? ~0ULL : 0;
+			prevSpace = 0;
+		}
+		if (!Fill())
+			return end;
+	}
+}
+
+bool StructuralIndex::SplitMembers(const char* begin, const char* end, const size_t gap, std::vector<const char*>& cuts)
+{
+	StructuralIndex state(begin, end);
+	//Offsets from begin, as the last partial block is classified from a padded copy
+	const char* from = begin;
+	size_t fromOffset{ 0 }, last{ 0 };
+	int64_t depth{ 0 };
+	bool bClosed = false;
+	const auto emit = [&](const char* block, const uint64_t quoteBits, const uint64_t backslash, const uint64_t openBits, const uint64_t closeBits, const uint64_t commaBits)
+	{
+		const auto quote = quoteBits & ~state.FindEscaped(backslash);
+		const auto inString = PrefixXor(quote) ^ state.prevInString;
+		state.prevInString = (uint64_t)((int64_t)inString >> 63);
+		const auto open = openBits & ~inString;
+		const auto close = closeBits & ~inString;
+
+		//Until a cut is due only the closing bracket is looked for, and a block that does not end at or below the top level can
+		//not hold it. Dipping to the top level and back within one would leave an unmatched bracket in some run, which fails to parse
+		const size_t offset = fromOffset + (block - from);
+		const int64_t lowest = depth - PopCount(close);
+		if (offset + 64 - last <= gap ? lowest + PopCount(open) > 0 : lowest >= 2)
+		{
+			depth = lowest + PopCount(open);
+			return true;
+		}
+		auto bits = open | close | (commaBits & ~inString);
+		while (bits)
+		{
+			const int i = TrailingZeros(bits);
+			bits &= bits - 1;
+			switch (block[i])
+			{
+			case ',':
+				if (depth == 1 && offset + i - last >= gap)
+				{
+					last = offset + i;
+					cuts.push_back(begin + last);
+				}
+				break;
+			case '{': case '[':
+				depth++;
+				break;
+			default:
+				if (--depth == 0)
+				{
+					cuts.push_back(begin + offset + i);
+					bClosed = true;
+					return false;
+				}
+				break;
+			}
+		}
+		return true;
+	};
+	const auto split = [&emit, &from](const char* stop)
+	{
+		switch (Selected())
+		{
+#ifdef STRUCTURAL_INDEX_X86
+		case Level::Avx2:
+			SplitAvx2(from, stop, emit);
+			break;
+		case Level::Sse2:
+			SplitSse2(from, stop, emit);
+			break;
+#endif
+		default:
+			SplitScalar(from, stop, emit);
+			break;
+		}
+	};
+
+	const char* blocksEnd = begin + (end - begin) / 64 * 64;
+	split(blocksEnd);
+	if (!bClosed && blocksEnd != end)
+	{
+		char block[64];
+		memset(block, ' ', sizeof(block));
+		memcpy(block, blocksEnd, end - blocksEnd);
+		from = block;
+		fromOffset = blocksEnd - begin;
+		split(block + sizeof(block));
+	}
+	return bClosed;
+}
+
+StructuralIndex::Level StructuralIndex::GetLevel()
+{
+	return Selected();
+}
+
+void StructuralIndex::SetLevel(const Level level)
+{
+	static const Level detected = Detect();
+	Selected() = std::min(level, detected);
+}
+
+bool StructuralIndex::Fill()
+{
+	if (cur == end)
+		return false;
+
+	//Windows only get shorter from here on, so the first one sizes the buffer for all of them
+	if (positions.empty())
+		positions.resize(std::min<size_t>(end - cur, WindowSize) + 64);
+	base = cur;
+	count = 0;
+	current = 0;
+	const char* windowEnd = end - cur > (ptrdiff_t)WindowSize ? cur + WindowSize : end;
+	const char* blocksEnd = cur + (windowEnd - cur) / 64 * 64;
+	Classify(cur, blocksEnd, 0);
+	if (blocksEnd != windowEnd)
+	{
+		//The last partial block is padded with spaces, which are never indexed
+		char block[64];
+		memset(block, ' ', sizeof(block));
+		memcpy(block, blocksEnd, windowEnd - blocksEnd);
+		Classify(block, block + sizeof(block), (uint32_t)(blocksEnd - base));
+	}
+	cur = windowEnd;
+	return true;
+}
+
+void StructuralIndex::Classify(const char* begin, const char* stop, uint32_t offset)
+{
+	const auto emit = [this, &offset](const uint64_t quote, const uint64_t backslash, const uint64_t space)
+	{
+		IndexBlock(quote, backslash, space, offset);
+		offset += 64;
+	};
+	switch (Selected())
+	{
+#ifdef STRUCTURAL_INDEX_X86
+	case Level::Avx2:
+		ClassifyAvx2(begin, stop, emit);
+		break;
+	case Level::Sse2:
+		ClassifySse2(begin, stop, emit);
+		break;
+#endif
+	default:
+		ClassifyScalar(begin, stop, emit);
+		break;
+	}
+}
+
+inline void StructuralIndex::IndexBlock(const uint64_t quoteBits, const uint64_t backslash, const uint64_t spaceBits, const uint32_t offset)
+{
+	const auto quote = quoteBits & ~FindEscaped(backslash);
+	//Set from an opening quote up to but not including its closing quote
+	const auto inString = PrefixXor(quote) ^ prevInString;
+	prevInString = (uint64_t)((int64_t)inString >> 63);
+	const auto inside = inString & ~quote;
+
+	const auto space = spaceBits & ~inString;
+	const auto afterSpace = ~space & ~inside & ((space << 1) | prevSpace);
+	prevSpace = space >> 63;
+
+	auto bits = (quote & ~inString) | (backslash & inside) | afterSpace;
+	auto out = positions.data() + count;
+	while (bits)
+	{
+		*out++ = offset + TrailingZeros(bits);
+		bits &= bits - 1;
+	}
+	count = out - positions.data();
+}
+
+//Marks the characters that follow an odd length run of backslashes, carrying a run that ends the block over to the next one
+uint64_t StructuralIndex::FindEscaped(const uint64_t backslash)
+{
+	constexpr uint64_t evenBits = 0x5555555555555555ULL;
+	constexpr uint64_t oddBits = ~evenBits;
+	const auto startEdges = backslash & ~(backslash << 1);
+	const auto evenStartMask = evenBits ^ prevOddBackslash;
+	const auto evenStarts = startEdges & evenStartMask;
+	const auto oddStarts = startEdges & ~evenStartMask;
+	const auto evenCarries = backslash + evenStarts;
+
+	uint64_t oddCarries;
+	const bool bEndsOdd = AddOverflow(backslash, oddStarts, oddCarries);
+	oddCarries |= prevOddBackslash;
+	prevOddBackslash = bEndsOdd ? 1 : 0;
+
+	const auto evenCarryEnds = evenCarries & ~backslash;
+	const auto oddCarryEnds = oddCarries & ~backslash;
+	return (evenCarryEnds & oddBits) | (oddCarryEnds & evenBits);
+}
+
+uint64_t StructuralIndex::PrefixXor(uint64_t bits)
+{
+	bits ^= bits << 1;
+	bits ^= bits << 2;
+	bits ^= bits << 4;
+	bits ^= bits << 8;
+	bits ^= bits << 16;
+	bits ^= bits << 32;
+	return bits;
+}
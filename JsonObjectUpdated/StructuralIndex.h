@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+//First parsing stage. Classifies the input 64 bytes at a time (AVX2 or SSE2 picked at runtime, scalar otherwise) and records
+//the closing quote of every string, the backslashes inside strings and the first character after every run of whitespace,
+//so the parser can jump over whitespace and string contents. Indexing goes one window at a time and only starts where the parser
+//first asks for a position, so stretches it never jumps through (short strings, single spaces) cost nothing.
+class StructuralIndex
+{
+public:
+	enum class Level { Scalar, Sse2, Avx2 };
+	static constexpr size_t WindowSize = 64 * 1024;
+
+	StructuralIndex(const char* begin, const char* end);
+	StructuralIndex(const StructuralIndex&) = delete;
+	StructuralIndex& operator=(const StructuralIndex&) = delete;
+
+	//First indexed position at or after pos, or the end of the input. Positions have to be asked for in increasing order,
+	//bInString tells whether pos is inside a string in case indexing has to start over from there
+	const char* Next(const char* pos, const bool bInString);
+
+	//Finds where the members of the array or object opening at begin can be split apart. Adds the first comma between members
+	//that lies at least gap bytes past the previous cut to cuts, then the closing bracket; false if the container never closes.
+	//Only the nesting is followed, so what lies between the cuts still has to be parsed to be known valid
+	static bool SplitMembers(const char* begin, const char* end, const size_t gap, std::vector<const char*>& cuts);
+
+	static Level GetLevel();
+	//Switches to a slower level than the detected one, asking for a faster one than the CPU supports is ignored
+	static void SetLevel(const Level level);
+
+private:
+	bool Fill();
+	void Classify(const char* begin, const char* stop, uint32_t offset);
+	void IndexBlock(const uint64_t quoteBits, const uint64_t backslash, const uint64_t spaceBits, const uint32_t offset);
+	uint64_t FindEscaped(const uint64_t backslash);
+	static uint64_t PrefixXor(uint64_t bits);
+
+	const char* cur;
+	const char* end;
+	const char* base;
+	std::vector<uint32_t> positions;
+	size_t count{ 0 };
+	size_t current{ 0 };
+	uint64_t prevOddBackslash{ 0 };
+	uint64_t prevInString{ 0 };
+	uint64_t prevSpace{ 0 };
+};